@@ -0,0 +1,9 @@
+#pragma once
+
+// Process-wide count of heap allocations made through operator new, for
+// checking that the steady-state frame path does not allocate. Linking
+// alloc_counter.cpp replaces the global operator new and delete; memory that
+// C code (SDL, FreeType) gets from malloc directly is not counted.
+
+// Allocations since the process started, across all threads
+unsigned long long HeapAllocationCount();
@@ -0,0 +1,91 @@
+#include "asset_pack.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+AssetPack::AssetPack() : data(nullptr), size(0), entries(nullptr), entryCount(0) {}
+
+AssetPack::~AssetPack() {
+    Close();
+}
+
+void AssetPack::Close() {
+    if (data) munmap(const_cast<uint8_t*>(data), size);
+    data = nullptr;
+    size = 0;
+    entries = nullptr;
+    entryCount = 0;
+}
+
+bool AssetPack::Open(const std::string& path) {
+    Close();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(PackHeader)) {
+        std::cerr << "Asset pack " << path << " is too small" << std::endl;
+        close(fd);
+        return false;
+    }
+    void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Failed to map asset pack " << path << ", Error: " << strerror(errno) << std::endl;
+        return false;
+    }
+    data = static_cast<const uint8_t*>(mapping);
+    size = st.st_size;
+
+    const PackHeader* header = reinterpret_cast<const PackHeader*>(data);
+    if (memcmp(header->magic, "EQPK", 4) != 0) {
+        std::cerr << "Asset pack " << path << " has a bad magic number" << std::endl;
+        Close();
+        return false;
+    }
+    if (header->version != ASSET_PACK_VERSION) {
+        std::cerr << "Asset pack " << path << " is version " << header->version
+                  << ", expected " << ASSET_PACK_VERSION << "; rebuild it with equis_pack" << std::endl;
+        Close();
+        return false;
+    }
+    if (header->entryCount > (size - sizeof(PackHeader)) / sizeof(PackEntry)) {
+        std::cerr << "Asset pack " << path << " has a truncated entry table" << std::endl;
+        Close();
+        return false;
+    }
+
+    const PackEntry* table = reinterpret_cast<const PackEntry*>(data + sizeof(PackHeader));
+    for (uint32_t i = 0; i < header->entryCount; i++) {
+        const PackEntry& entry = table[i];
+        bool valid = entry.name[sizeof(entry.name) - 1] == '\0'
+                     && entry.offset <= size && entry.size <= size - entry.offset;
+        if (valid && entry.type == PACK_ENTRY_RGBA) {
+            valid = entry.size == (uint64_t)entry.width * entry.height * 4;
+        }
+        if (!valid) {
+            std::cerr << "Asset pack " << path << " has a corrupt entry (#" << i << ")" << std::endl;
+            Close();
+            return false;
+        }
+    }
+
+    entries = table;
+    entryCount = header->entryCount;
+    return true;
+}
+
+const PackEntry* AssetPack::Find(const std::string& name) const {
+    for (uint32_t i = 0; i < entryCount; i++) {
+        if (name == entries[i].name) {
+            return &entries[i];
+        }
+    }
+    return nullptr;
+}
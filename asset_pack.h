@@ -0,0 +1,91 @@
+#pragma once
+
+// Pre-baked asset pack: every required file in one memory-mapped blob.
+// Images are stored as raw RGBA32 already scaled down to the largest size they
+// are drawn at, so loading is a texture upload straight from the mapping.
+// The font and the BGM are stored as their original file bytes.
+// Built offline by equis_pack; the layout is little-endian.
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+const char* const ASSET_PACK_FILE = "equis.pack";
+const uint32_t ASSET_PACK_VERSION = 1;
+const size_t ASSET_PACK_ALIGNMENT = 64;
+
+// Horse portraits are drawn HORSE_SPRITE_SIZE (200) wide at zoom 1 and up
+// to HORSE_MAX_ZOOM (2x) times that, so they are baked for the largest zoom
+const int HORSE_PORTRAIT_BAKE_SIZE = 400;
+
+// Files the game needs, with the largest size they are drawn at (0 = not an
+// image). Keep in sync with DrawUI()/DrawHorses().
+struct AssetSpec {
+    const char* name;
+    int drawWidth;
+    int drawHeight;
+};
+
+const AssetSpec REQUIRED_ASSETS[] = {
+    {"0.png", 1250, 690},  // Background, drawn full window
+    {"1.png", HORSE_PORTRAIT_BAKE_SIZE, HORSE_PORTRAIT_BAKE_SIZE},  // Horse portraits
+    {"2.png", HORSE_PORTRAIT_BAKE_SIZE, HORSE_PORTRAIT_BAKE_SIZE},
+    {"3.png", HORSE_PORTRAIT_BAKE_SIZE, HORSE_PORTRAIT_BAKE_SIZE},
+    {"4.png", HORSE_PORTRAIT_BAKE_SIZE, HORSE_PORTRAIT_BAKE_SIZE},
+    {"5.png", HORSE_PORTRAIT_BAKE_SIZE, HORSE_PORTRAIT_BAKE_SIZE},
+    {"6.png", HORSE_PORTRAIT_BAKE_SIZE, HORSE_PORTRAIT_BAKE_SIZE},
+    {"7.png", 150, 150},   // Girl
+    {"race_bgm.mp3", 0, 0},
+    {"KaiseiTokumin-Bold.ttf", 0, 0},
+};
+const size_t REQUIRED_ASSET_COUNT = sizeof(REQUIRED_ASSETS) / sizeof(REQUIRED_ASSETS[0]);
+
+enum PackEntryType : uint32_t {
+    PACK_ENTRY_RGBA = 1,  // width * height * 4 bytes, tightly packed rows
+    PACK_ENTRY_BLOB = 2,  // Original file contents
+};
+
+struct PackHeader {
+    char magic[4];        // "EQPK"
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+};
+
+struct PackEntry {
+    char name[32];        // NUL-terminated
+    uint32_t type;
+    uint32_t width;
+    uint32_t height;
+    uint32_t reserved;
+    uint64_t offset;      // From the start of the file, ASSET_PACK_ALIGNMENT aligned
+    uint64_t size;
+};
+
+static_assert(sizeof(PackHeader) == 16, "PackHeader layout is part of the file format");
+static_assert(sizeof(PackEntry) == 64, "PackEntry layout is part of the file format");
+
+// Read-only view of a pack file mapped into memory
+class AssetPack {
+public:
+    AssetPack();
+    ~AssetPack();
+
+    AssetPack(const AssetPack&) = delete;
+    AssetPack& operator=(const AssetPack&) = delete;
+
+    // Map and validate the pack. Returns false (and stays closed) if the file
+    // is missing, has another version or is malformed.
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const { return data != nullptr; }
+
+    const PackEntry* Find(const std::string& name) const;
+    const uint8_t* Data(const PackEntry& entry) const { return data + entry.offset; }
+
+private:
+    const uint8_t* data;
+    size_t size;
+    const PackEntry* entries;
+    uint32_t entryCount;
+};
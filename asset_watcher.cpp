@@ -0,0 +1,63 @@
+#include "asset_watcher.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <sys/inotify.h>
+#include <unistd.h>
+
+AssetWatcher::AssetWatcher() : fd(-1) {}
+
+AssetWatcher::~AssetWatcher() {
+    Stop();
+}
+
+bool AssetWatcher::Start(const std::string& directory) {
+    Stop();
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Failed to start watching assets: " << strerror(errno) << std::endl;
+        return false;
+    }
+    // Writes in place end with CLOSE_WRITE; editors that save to a temporary
+    // file and rename it over the original end with MOVED_TO
+    if (inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        std::cerr << "Failed to watch " << directory << ": " << strerror(errno) << std::endl;
+        Stop();
+        return false;
+    }
+    return true;
+}
+
+void AssetWatcher::Stop() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    pending.clear();
+}
+
+void AssetWatcher::Poll(std::vector<std::string>& settled, int quietMs) {
+    if (fd < 0) return;
+
+    alignas(inotify_event) char buffer[4096];
+    Clock::time_point now = Clock::now();
+    while (true) {
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length <= 0) break; // EAGAIN: nothing more for now
+        for (ssize_t offset = 0; offset < length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            if (event->len > 0) pending[event->name] = now;
+            offset += sizeof(inotify_event) + event->len;
+        }
+    }
+
+    for (auto it = pending.begin(); it != pending.end();) {
+        if (now - it->second >= std::chrono::milliseconds(quietMs)) {
+            settled.push_back(it->first);
+            it = pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+// Watches one directory with inotify for files that were rewritten or moved
+// into place. Editors often save in several writes, so a file is reported
+// only once it has been quiet for a while. Poll() never blocks; it is meant
+// to be called once per frame. Nothing in here depends on SDL.
+class AssetWatcher {
+public:
+    AssetWatcher();
+    ~AssetWatcher();
+
+    AssetWatcher(const AssetWatcher&) = delete;
+    AssetWatcher& operator=(const AssetWatcher&) = delete;
+
+    // Returns false if the directory cannot be watched
+    bool Start(const std::string& directory);
+    void Stop();
+    bool IsWatching() const { return fd >= 0; }
+
+    // Append to settled the names (relative to the directory) changed since
+    // the last report whose latest change is at least quietMs old
+    void Poll(std::vector<std::string>& settled, int quietMs);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    int fd;
+    std::map<std::string, Clock::time_point> pending;   // Name -> last change
+};
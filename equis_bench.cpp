@@ -0,0 +1,356 @@
+// Micro and macro benchmarks.
+// Everything renders into an offscreen surface with SDL's software renderer,
+// so this runs on build machines without a GPU or a display. Results are
+// printed as JSON for tracking across releases.
+//
+//   ./equis_bench [--reps N] [--warmup N] [--filter TEXT] [--json FILE]
+
+#include "equis_game.h"
+#include "payout.h"
+#include <fstream>
+#include <functional>
+#include <ctime>
+
+// Test hooks into HorseRacingGame (declared a friend there)
+struct GameBench {
+    static int DrawText(HorseRacingGame& game, const std::string& text) {
+        SDL_Color color = {255, 255, 255, 255};
+        return game.DrawText(text, 10, 10, color);
+    }
+
+    // What every label cost per frame before the glyph atlas: rasterize, upload, copy, destroy
+    static void RenderTextPerFrame(HorseRacingGame& game, const std::string& text) {
+        SDL_Color color = {255, 255, 255, 255};
+        SDL_Texture* texture = game.RenderText(text, color);
+        if (texture) {
+            SDL_Rect rect = {10, 10, 0, 0};
+            SDL_QueryTexture(texture, NULL, NULL, &rect.w, &rect.h);
+            SDL_RenderCopy(game.renderer, texture, NULL, &rect);
+            SDL_DestroyTexture(texture);
+        }
+    }
+
+    static void SetRacing(HorseRacingGame& game, bool racing) {
+        game.gameState.isRacing = racing;
+        game.gameState.raceFinished = false;
+        game.raceElapsed = 0;
+        game.raceDuration = 1e9; // Update() ends races by game time; keep this one going
+        game.PublishSnapshot();
+    }
+
+    static void ShowResult(HorseRacingGame& game) {
+        for (size_t i = 0; i < game.gameState.contributions.size(); i++) {
+            game.gameState.contributions[i] = (long long)(i + 1) * CONTRIBUTION_AMOUNT;
+        }
+        game.gameState.standings.Rebuild(game.gameState.contributions);
+        game.gameState.odds.Rebuild(game.gameState.contributions);
+        game.gameState.isRacing = false;
+        game.RecordRaceResult();
+        game.gameState.raceFinished = true;
+        game.PublishSnapshot();
+    }
+
+    static void SetProfilerOverlay(HorseRacingGame& game, bool visible) {
+        game.showProfiler = visible;
+    }
+};
+
+struct BenchOptions {
+    int reps;
+    int warmup;
+    std::string filter;
+
+    BenchOptions() : reps(30), warmup(5) {}
+};
+
+struct BenchResult {
+    std::string name;
+    long long iterations;   // Per repetition
+    int reps;
+    double meanNs, medianNs, minNs, maxNs, stddevNs;
+};
+
+template <typename T>
+static void DoNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Time body over `reps` repetitions of `iterations` calls each, after `warmup`
+// untimed repetitions. Statistics are per call.
+static bool RunBench(std::vector<BenchResult>& results, const BenchOptions& options, const std::string& name,
+                     long long iterations, const std::function<void()>& body) {
+    if (!options.filter.empty() && name.find(options.filter) == std::string::npos) return false;
+
+    for (int rep = 0; rep < options.warmup; rep++) {
+        for (long long i = 0; i < iterations; i++) body();
+    }
+
+    std::vector<double> samples;
+    samples.reserve(options.reps);
+    for (int rep = 0; rep < options.reps; rep++) {
+        auto start = std::chrono::steady_clock::now();
+        for (long long i = 0; i < iterations; i++) body();
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        samples.push_back(ns / iterations);
+    }
+
+    BenchResult result;
+    result.name = name;
+    result.iterations = iterations;
+    result.reps = options.reps;
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (double sample : samples) sum += sample;
+    result.meanNs = sum / samples.size();
+    result.medianNs = samples[samples.size() / 2];
+    result.minNs = samples.front();
+    result.maxNs = samples.back();
+    double squares = 0;
+    for (double sample : samples) squares += (sample - result.meanNs) * (sample - result.meanNs);
+    result.stddevNs = std::sqrt(squares / samples.size());
+
+    std::cerr << std::left << std::setw(36) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(14) << result.medianNs << " ns  (min " << result.minNs << ", max " << result.maxNs << ")"
+              << std::defaultfloat << std::endl;
+    results.push_back(result);
+    return true;
+}
+
+static void WriteJson(std::ostream& out, const std::vector<BenchResult>& results) {
+    SDL_version linked;
+    SDL_GetVersion(&linked);
+    std::time_t now = std::time(nullptr);
+    char timestamp[32];
+    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    out << "{\n";
+    out << "  \"timestamp\": \"" << timestamp << "\",\n";
+    out << "  \"sdl\": \"" << (int)linked.major << "." << (int)linked.minor << "." << (int)linked.patch << "\",\n";
+    out << "  \"renderer\": \"software\",\n";
+    out << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+    out << "  \"benchmarks\": [\n";
+    out << std::fixed << std::setprecision(2);
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations << ", \"reps\": " << r.reps
+            << ", \"mean_ns\": " << r.meanNs << ", \"median_ns\": " << r.medianNs
+            << ", \"min_ns\": " << r.minNs << ", \"max_ns\": " << r.maxNs << ", \"stddev_ns\": " << r.stddevNs << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    std::string jsonPath;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--reps") && hasValue) {
+            options.reps = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--warmup") && hasValue) {
+            options.warmup = std::max(0, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--filter") && hasValue) {
+            options.filter = argv[++i];
+        } else if (!strcmp(argv[i], "--json") && hasValue) {
+            jsonPath = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--reps N] [--warmup N] [--filter TEXT] [--json FILE]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<BenchResult> results;
+
+    // Race core, no SDL involved
+    {
+        long long amounts[] = {5000, 10000000, 300000000, 123450000};
+        size_t next = 0;
+        RunBench(results, options, "FormatMoney", 100000, [&]() {
+            std::string text = FormatMoney(amounts[next++ & 3]);
+            DoNotOptimize(text);
+        });
+        RunBench(results, options, "FormatMoney/buffer", 100000, [&]() {
+            char text[MONEY_TEXT_MAX];
+            size_t length = FormatMoney(amounts[next++ & 3], text, sizeof(text));
+            DoNotOptimize(length);
+            DoNotOptimize(text);
+        });
+
+        RaceRng rng(42);
+        for (int horses : {6, 10000}) {
+            std::vector<long long> contributions;
+            RaceConfig config;
+            config.numHorses = horses;
+            SimulateRaceInstant(config, rng, contributions);
+            long long iterations = horses > 100 ? 200 : 100000;
+
+            RunBench(results, options, "RankHorses/" + std::to_string(horses), iterations, [&]() {
+                std::vector<size_t> ranking = RankHorses(contributions);
+                DoNotOptimize(ranking);
+            });
+            RunBench(results, options, "CalculatePrize/" + std::to_string(horses), iterations, [&]() {
+                long long prize = CalculatePrize(contributions);
+                DoNotOptimize(prize);
+            });
+
+            // One contribution applied to a live ranking, then the prize read back
+            Leaderboard standings;
+            standings.Rebuild(contributions);
+            RunBench(results, options, "Leaderboard/Update/" + std::to_string(horses), 100000, [&]() {
+                size_t horse = (size_t)PickSimulatedHorse(rng, horses);
+                contributions[horse] += CONTRIBUTION_AMOUNT;
+                standings.Update(contributions, horse);
+                DoNotOptimize(standings.Prize(contributions));
+            });
+        }
+
+        // The largest field with every horse tied: each contribution moves a
+        // horse out of a tie with nearly all of the others
+        {
+            std::vector<long long> contributions(MAX_HORSES, CONTRIBUTION_AMOUNT);
+            Leaderboard standings;
+            standings.Rebuild(contributions);
+            RunBench(results, options, "Leaderboard/Update/ties/" + std::to_string(MAX_HORSES), 100000, [&]() {
+                size_t horse = (size_t)PickSimulatedHorse(rng, MAX_HORSES);
+                contributions[horse] += CONTRIBUTION_AMOUNT;
+                standings.Update(contributions, horse);
+                DoNotOptimize(standings.Prize(contributions));
+            });
+        }
+
+        // Settling a large event: a million bettors with a few bets each
+        for (int horses : {6, 10000}) {
+            BetBook book(horses);
+            const size_t bets = 4000000;
+            std::vector<BetSlot> bettors(1000000);
+            book.Reserve(bets);
+            std::vector<long long> totals(horses, 0);
+            for (size_t i = 0; i < bets; i++) {
+                int horse = PickSimulatedHorse(rng, horses);
+                long long amount = (long long)(rng() % 100 + 1) * 1000;
+                book.Add(bettors[rng() % bettors.size()], horse, amount);
+                totals[horse] += amount;
+            }
+            size_t places[PRIZE_PLACES];
+            int placeCount = TopHorses(totals, places, PRIZE_PLACES);
+            PayoutRules rules;
+            rules.poolShares = {0.6, 0.3, 0.1};
+            rules.takeout = 0.2;
+            Settlement settlement;
+            RunBench(results, options, "SettleRace/4M/" + std::to_string(horses), 1, [&]() {
+                SettleRace(book, places, placeCount, rules, settlement);
+                DoNotOptimize(settlement.paid);
+            });
+        }
+    }
+
+    // Rendering, against an offscreen software renderer
+    SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+    if (SDL_Init(SDL_INIT_TIMER) < 0 || TTF_Init() == -1 || !(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG)) {
+        std::cerr << "SDL could not initialize! SDL_Error: " << SDL_GetError() << std::endl;
+        return 1;
+    }
+    SDL_Surface* target;
+    SDL_Renderer* renderer = CreateOffscreenRenderer(&target);
+    if (!renderer) {
+        std::cerr << "Software renderer could not be created! SDL_Error: " << SDL_GetError() << std::endl;
+        return 1;
+    }
+
+    {
+        HorseRacingGame game(nullptr, renderer);
+
+        std::string source;
+        for (int i = 0; i < 4; i++) {
+            source += "ゲーム状態: 待機中 | スペースキーでレース開始 | Cキーで馬に貢ぐ | ESCで終了 ";
+        }
+        for (size_t length : {8, 32, 128}) {
+            // First `length` characters, cut on a UTF-8 boundary
+            size_t pos = 0;
+            for (size_t characters = 0; characters < length && pos < source.size(); characters++) {
+                DecodeUTF8(source.data(), source.size(), pos);
+            }
+            std::string text = source.substr(0, pos);
+            std::string suffix = "/" + std::to_string(length);
+            RunBench(results, options, "RenderText" + suffix, 50, [&]() {
+                GameBench::RenderTextPerFrame(game, text);
+            });
+            RunBench(results, options, "DrawText" + suffix, 500, [&]() {
+                DoNotOptimize(GameBench::DrawText(game, text));
+            });
+        }
+
+        GameBench::SetRacing(game, false);
+        RunBench(results, options, "DrawUI/idle", 20, [&]() {
+            game.DrawUI();
+        });
+        // Same frame with the cached layers thrown away every time
+        RunBench(results, options, "DrawUI/idle/full-redraw", 20, [&]() {
+            game.InvalidateLayers();
+            game.DrawUI();
+        });
+
+        GameBench::SetRacing(game, true);
+        RunBench(results, options, "DrawUI/racing", 20, [&]() {
+            game.Update(1.0 / DEFAULT_TICK_RATE);
+            game.DrawUI(0.5);
+        });
+
+        GameBench::ShowResult(game);
+        RunBench(results, options, "DrawUI/result", 20, [&]() {
+            game.DrawUI();
+        });
+
+        GameBench::SetProfilerOverlay(game, true);
+        RunBench(results, options, "DrawUI/result+profiler", 20, [&]() {
+            game.BeginFrame();
+            game.DrawUI();
+        });
+    } // The game destroys the renderer
+    SDL_FreeSurface(target);
+
+    // Large field: the whole grid visible at minimum zoom, then zoomed in to a few dozen cells
+    renderer = CreateOffscreenRenderer(&target);
+    if (!renderer) {
+        std::cerr << "Software renderer could not be created! SDL_Error: " << SDL_GetError() << std::endl;
+        return 1;
+    }
+    {
+        HorseRacingGame game(nullptr, renderer, 10000);
+        GameBench::SetRacing(game, true);
+        game.ZoomHorseView(0, 0, 0);
+        RunBench(results, options, "DrawUI/racing/10000/all", 10, [&]() {
+            game.Update(1.0 / DEFAULT_TICK_RATE);
+            game.DrawUI(0.5);
+        });
+        game.ResetHorseView();
+        game.PanHorseView(5000, 5000);
+        RunBench(results, options, "DrawUI/racing/10000/zoom1", 20, [&]() {
+            game.Update(1.0 / DEFAULT_TICK_RATE);
+            game.DrawUI(0.5);
+        });
+
+        GameBench::ShowResult(game);
+        RunBench(results, options, "DrawUI/result/10000", 20, [&]() {
+            game.DrawUI();
+        });
+    }
+
+    SDL_FreeSurface(target);
+    TTF_Quit();
+    IMG_Quit();
+    SDL_Quit();
+
+    if (jsonPath.empty()) {
+        WriteJson(std::cout, results);
+    } else {
+        std::ofstream file(jsonPath);
+        if (!file) {
+            std::cerr << "Failed to open " << jsonPath << std::endl;
+            return 1;
+        }
+        WriteJson(file, results);
+        std::cerr << "Wrote " << jsonPath << std::endl;
+    }
+    return 0;
+}
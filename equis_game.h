@@ -0,0 +1,1599 @@
+#pragma once
+
+// The game itself: state, resources and HorseRacingGame. Shared by the
+// equis_linux entry point and the tools that drive the game without a player.
+
+#include <SDL.h>
+#include <SDL_image.h>
+#include <SDL_mixer.h>
+#include <SDL_ttf.h>
+#include <string>
+#include <vector>
+#include <random>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <map>
+#include <set>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+
+#include "asset_pack.h"
+#include "asset_watcher.h"
+#include "frame_arena.h"
+#include "frame_profiler.h"
+#include "glyph_atlas.h"
+#include "journal.h"
+#include "mpsc_queue.h"
+#include "race_core.h"
+#include "race_history.h"
+#include "race_recording.h"
+#include "task_scheduler.h"
+
+// Game constants
+const int WINDOW_WIDTH = 1250;
+const int WINDOW_HEIGHT = 690;
+const int DEFAULT_TICK_RATE = 120;          // Simulation ticks per second
+const double BG_SCROLL_SPEED = 200.0;       // Pixels per second
+const double MAX_FRAME_SECONDS = 0.25;      // Clamp for long stalls so the loop never spirals
+const int DEFAULT_HORSES = 6;
+const int MAX_HORSES = 100000;
+const int HORSE_SPRITES = 6;                // 1.png-6.png, reused in turn by larger fields
+const int CONTRIBUTION_LIST_MAX = 6;        // Horses named in the contribution line; larger fields show the leaders
+const int CONTRIBUTION_QUEUE_CAPACITY = 4096;
+const int CONTRIBUTION_BATCH = 1024;        // Most contributions applied per tick; the rest wait for the next
+
+// Horse grid. Cells are laid out in world pixels (zoom 1) and shown through
+// HORSE_VIEW; with six horses the whole grid fits the view at zoom 1.
+const SDL_Rect HORSE_VIEW = {530, 80, 700, 470};
+const int HORSE_GRID_MARGIN_X = 20;
+const int HORSE_GRID_MARGIN_Y = 10;
+const int HORSE_CELL_WIDTH = 220;
+const int HORSE_CELL_HEIGHT = 210;
+const int HORSE_SPRITE_SIZE = 200;
+const int HORSE_NAME_HEIGHT = 30;
+constexpr double HORSE_MAX_ZOOM = 2.0;
+static_assert(HORSE_SPRITE_SIZE * HORSE_MAX_ZOOM <= HORSE_PORTRAIT_BAKE_SIZE, "Portraits would be magnified past their packed size");
+const double HORSE_NAME_MIN_ZOOM = 0.6;     // Names are not scaled, so they are left out below this
+
+const SDL_Rect GIRL_RECT = {1020, 510, 150, 150};
+const char* const FONT_FILE = "KaiseiTokumin-Bold.ttf";
+const int FONT_SIZE = 24;
+const int ASSET_SETTLE_MS = 100;            // Hot reload waits until a changed file has been quiet this long
+
+// Screen bands redrawn when what they show changes (see DrawUI)
+const SDL_Rect CONTRIBUTIONS_RECT = {0, 0, WINDOW_WIDTH, 50};
+const SDL_Rect PROMPT_RECT = {0, 50, WINDOW_WIDTH, 80};
+const SDL_Rect RESULT_RECT = {0, 400, WINDOW_WIDTH, 30 * (PRIZE_PLACES + 2)};
+const SDL_Rect DEBUG_INFO_RECT = {0, WINDOW_HEIGHT - 30, WINDOW_WIDTH, 30};
+const size_t MAX_DAMAGE_RECTS = 8;          // More than this and the frame is redrawn in one piece
+const size_t FRAME_TEXT_MAX = 512;          // Bytes per line of text built during a frame
+
+// One contribution on its way from a producer (player, script or the race
+// simulation) to the tick that applies it
+struct ContributionCommand {
+    int horse;
+    long long amount;
+};
+
+// Game state.
+// Per-horse data is kept as one array per field, all indexed by horse, so
+// passes over the whole field touch only the field they need.
+// contributions and previousResults are only written by the main thread:
+// other threads send ContributionCommands, which Update() applies. Everything
+// the renderer needs is published through GameSnapshot instead of being read
+// from here.
+struct GameState {
+    std::vector<std::string> horseNames;
+    std::vector<unsigned char> horseSprites;  // Index into UIResources::horseImages
+    std::vector<long long> contributions;
+    std::vector<long long> previousResults;
+    Leaderboard standings;      // Ranking of contributions, updated with every change
+    Leaderboard results;        // Ranking of previousResults
+    unsigned resultsVersion;    // Changes whenever previousResults and results do
+    PoolOdds odds;              // Pool of contributions, updated with every change
+    std::atomic<bool> isRacing;
+    bool skipConfirmation;
+    std::atomic<bool> raceFinished;
+
+    explicit GameState(int numHorses = DEFAULT_HORSES) :
+        contributions(numHorses, 0),
+        previousResults(numHorses, 0),
+        resultsVersion(1),      // Snapshots start at 0, so the first publish copies the winners
+        isRacing(false),
+        skipConfirmation(false),
+        raceFinished(false) {
+        static const char* const BASE_NAMES[HORSE_SPRITES] = {
+            "クラウドナイト", "ダンディオン", "ルシフェルウィング",
+            "アレスフレア", "レオンハート", "ゼウスブレイド"
+        };
+        horseNames.reserve(numHorses);
+        horseSprites.reserve(numHorses);
+        for (int i = 0; i < numHorses; i++) {
+            // The first six keep their names; later ones are numbered after them
+            std::string name = BASE_NAMES[i % HORSE_SPRITES];
+            if (i >= HORSE_SPRITES) name += std::to_string(i / HORSE_SPRITES + 1);
+            horseNames.push_back(name);
+            horseSprites.push_back((unsigned char)(i % HORSE_SPRITES));
+        }
+        standings.Rebuild(contributions);
+        results.Rebuild(previousResults);
+        odds.Rebuild(contributions);
+    }
+};
+
+// View of GameState that drawing reads. Update() refreshes it with
+// PublishSnapshot() and DrawUI() reads it, both on the main thread.
+// Only what is drawn is copied: the horses in the contribution line are
+// picked off the leaderboard when publishing, along with their amounts, so
+// neither publishing nor drawing depends on the size of the field. The last
+// race's winners only change when a race ends, so they are copied only then.
+struct GameSnapshot {
+    size_t shown[CONTRIBUTION_LIST_MAX];    // Horses in the contribution line
+    long long shownAmounts[CONTRIBUTION_LIST_MAX];
+    int shownCount;
+    size_t winners[PRIZE_PLACES];           // Last race, best first
+    long long winnerAmounts[PRIZE_PLACES];
+    int winnerCount;
+    long long prize;                        // For the last race
+    unsigned resultsVersion;                // GameState::resultsVersion the winners are from
+    PoolOdds odds;                          // Current pool; odds of a horse from its contributions
+    bool isRacing;
+    bool raceFinished;
+    unsigned version;                       // Changes with every publish
+
+    GameSnapshot() : shownCount(0), winnerCount(0), prize(0), resultsVersion(0), isRacing(false), raceFinished(false), version(0) {}
+};
+
+// UI Resources
+struct UIResources {
+    SDL_Texture* bgImage;
+    std::vector<SDL_Texture*> horseImages;
+    SDL_Texture* girlImage;
+    TTF_Font* font;
+    GlyphAtlas* textAtlas; // Glyph cache for all per-frame text
+    AssetPack pack;        // Mapped equis.pack, if present; the font and BGM read from it while open
+    std::vector<char> fontData; // Backs font after it was hot reloaded
+
+    UIResources() : bgImage(nullptr), girlImage(nullptr), font(nullptr), textAtlas(nullptr) {}
+    ~UIResources() { Release(); }
+
+    // Free everything; safe to call more than once. ~HorseRacingGame() calls
+    // it before destroying the renderer the textures belong to.
+    void Release() {
+        if (bgImage) SDL_DestroyTexture(bgImage);
+        bgImage = nullptr;
+        for (auto& horseImage : horseImages) {
+            if (horseImage) SDL_DestroyTexture(horseImage);
+        }
+        horseImages.clear();
+        if (girlImage) SDL_DestroyTexture(girlImage);
+        girlImage = nullptr;
+        delete textAtlas;
+        textAtlas = nullptr;
+        if (font) {
+            TTF_CloseFont(font);
+            font = nullptr;
+        }
+        // Only once the font that reads from them is closed
+        std::vector<char>().swap(fontData);
+        pack.Close();
+    }
+};
+
+class HorseRacingGame {
+    friend struct GameBench; // equis_bench.cpp drives private drawing paths directly
+
+private:
+    SDL_Window* window;
+    SDL_Renderer* renderer;
+    GameState gameState;
+    GameSnapshot snapshot;          // What the last PublishSnapshot() left for DrawUI()
+    unsigned snapshotVersion;
+    UIResources resources;
+    FrameProfiler profiler;
+    FrameArena frameArena;          // Text built while drawing a frame; reset after every present
+    bool showProfiler;              // F3 overlay
+    TaskScheduler scheduler;        // Long-lived workers for asset decoding
+    MpscQueue<ContributionCommand> contributionQueue; // Every contribution, drained by Update()
+    Journal journal;                // Every applied contribution and race result, if enabled
+    RaceHistory history;            // Every race result, if enabled
+    std::vector<uint32_t> historyFinish;    // Scratch rows for the history
+    std::vector<long long> historyPayouts;
+    Mix_Music* bgm;               // Loaded once; freed with the game
+    bool resourcesLoaded;
+
+    // Race clock: game time from Update(), so it follows whatever clock drives the loop
+    int raceId;                   // Races started so far
+    double raceSeconds;           // 0 = use the BGM track length
+    double raceDuration;          // Length of the current race
+
+    // Fixed-timestep simulation state, advanced only by Update()
+    double scrollOffset;          // Background scroll after the latest tick
+    double previousScrollOffset;  // Background scroll after the tick before, for interpolation
+    double raceElapsed;           // Seconds of race time simulated so far
+    long long raceTick;           // Ticks simulated so far in this race
+    RaceSimulator raceSimulator;  // Simulated contributions, advanced by Update()
+    uint64_t raceSeed;
+    bool fixedSeed;               // Seed races from baseSeed instead of std::random_device
+    uint64_t baseSeed;
+
+    // Race recording, when a directory is set: seed, starting totals and every
+    // outside contribution with the tick it was applied on
+    std::string recordDirectory;
+    RaceRecording recording;
+    bool recordingRace;
+
+    // Horse grid view, main thread only
+    int gridColumns;
+    double viewX, viewY;          // World position at the top-left of HORSE_VIEW
+    double viewZoom;
+
+    // In-window contribution prompt, main thread only
+    enum InputMode { INPUT_NONE, INPUT_HORSE_NUMBER, INPUT_CONFIRM };
+    InputMode inputMode;
+    std::string inputDigits;      // Horse number typed so far
+    int inputHorse;               // Horse awaiting confirmation
+
+    // Reused between frames: one vertex batch per horse sprite, plus one for
+    // horses whose sprite failed to load, sharing a single quad index list
+    std::vector<SDL_Vertex> horseBatches[HORSE_SPRITES + 1];
+    std::vector<int> quadIndices;
+
+    // Cached layers, main thread only. Both are null when the renderer cannot
+    // draw into textures, and DrawUI() then draws everything every frame.
+    SDL_Texture* staticLayer;     // Horse grid, names and girl over transparency; rebuilt when the view changes
+    SDL_Texture* frameTexture;    // The composed frame; only damaged rects are redrawn into it
+    bool layersCreated;
+    bool staticLayerValid;
+    bool frameValid;
+    std::vector<SDL_Rect> damage; // Rects of frameTexture to redraw this frame
+
+    // Hot reload: changed asset files are decoded on the scheduler and swapped
+    // in by BeginFrame(), between two frames
+    struct AssetReload;
+    AssetWatcher assetWatcher;
+    std::map<std::string, std::unique_ptr<AssetReload>> assetReloads;  // In flight, by file name
+    std::set<std::string> assetsChangedAgain;  // Changed again while their reload was in flight
+    std::vector<std::string> changedAssets;    // Reused by ReloadChangedAssets()
+
+    // What frameTexture currently shows, to find the damage
+    unsigned drawnSnapshotVersion;
+    long drawnBackgroundX;
+    std::string drawnDebugText;
+    std::string drawnPrompt;
+    bool drawnProfiler;
+
+    // Render text into a standalone texture. Everything drawn per frame goes
+    // through DrawText() instead; equis_bench keeps this for comparison.
+    SDL_Texture* RenderText(const std::string& text, SDL_Color color) {
+        PROFILE_SCOPE(profiler, "RenderText");
+        if (!resources.font) {
+            std::cerr << "Error: Font not loaded!" << std::endl;
+            return nullptr;
+        }
+        SDL_Surface* surface = TTF_RenderUTF8_Blended(resources.font, text.c_str(), color);
+        if (!surface) {
+            std::cerr << "Failed to render text: " << TTF_GetError() << std::endl;
+            return nullptr;
+        }
+        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
+        SDL_FreeSurface(surface);
+        return texture;
+    }
+
+    // Bring snapshot up to date with gameState. Update() calls this on the
+    // main thread, which is also the one that draws, so it is written in place.
+    void PublishSnapshot() {
+        // Small fields are listed in order; large ones show their leaders only
+        if (HorseCount() <= CONTRIBUTION_LIST_MAX) {
+            snapshot.shownCount = HorseCount();
+            for (int i = 0; i < snapshot.shownCount; i++) snapshot.shown[i] = i;
+        } else {
+            snapshot.shownCount = gameState.standings.Top(snapshot.shown, CONTRIBUTION_LIST_MAX);
+        }
+        for (int i = 0; i < snapshot.shownCount; i++) snapshot.shownAmounts[i] = gameState.contributions[snapshot.shown[i]];
+        if (snapshot.resultsVersion != gameState.resultsVersion) {
+            snapshot.winnerCount = gameState.results.Top(snapshot.winners, PRIZE_PLACES);
+            for (int i = 0; i < snapshot.winnerCount; i++) snapshot.winnerAmounts[i] = gameState.previousResults[snapshot.winners[i]];
+            snapshot.prize = gameState.results.Prize(gameState.previousResults);
+            snapshot.resultsVersion = gameState.resultsVersion;
+        }
+        snapshot.odds = gameState.odds;
+        snapshot.isRacing = gameState.isRacing;
+        snapshot.raceFinished = gameState.raceFinished;
+        snapshot.version = ++snapshotVersion;
+    }
+
+    // Apply up to max queued contributions. Returns whether any were applied.
+    bool ApplyQueuedContributions(size_t max) {
+        size_t applied = contributionQueue.Drain(max, [this](const ContributionCommand& command) {
+            AddContribution(command.horse, command.amount);
+            if (recordingRace) {
+                RecordedContribution recorded = {raceTick, command.horse, command.amount};
+                recording.contributions.push_back(recorded);
+            }
+        });
+        return applied > 0;
+    }
+
+    // Main thread only (see GameState)
+    void AddContribution(size_t horseIndex, long long amount) {
+        gameState.contributions[horseIndex] += amount;
+        gameState.standings.Update(gameState.contributions, horseIndex);
+        gameState.odds.Add(amount);
+        if (journal.IsOpen()) journal.Append(JOURNAL_CONTRIBUTION, (int32_t)horseIndex, amount);
+    }
+
+    // Draw text through the glyph atlas. Returns the drawn width.
+    int DrawText(const std::string& text, int x, int y, SDL_Color color) {
+        PROFILE_SCOPE(profiler, "DrawText");
+        if (!resources.textAtlas) {
+            return 0;
+        }
+        return resources.textAtlas->DrawText(text, x, y, color);
+    }
+
+    int DrawText(const char* text, int x, int y, SDL_Color color) {
+        PROFILE_SCOPE(profiler, "DrawText");
+        if (!resources.textAtlas) {
+            return 0;
+        }
+        return resources.textAtlas->DrawText(text, strlen(text), x, y, color);
+    }
+
+    int DrawText(const FrameText& text, int x, int y, SDL_Color color) {
+        PROFILE_SCOPE(profiler, "DrawText");
+        if (!resources.textAtlas) {
+            return 0;
+        }
+        return resources.textAtlas->DrawText(text.Data(), text.Length(), x, y, color);
+    }
+
+    static void AppendMoney(FrameText& text, long long amount) {
+        char* out = text.Reserve(MONEY_TEXT_MAX);
+        if (out) text.Commit(FormatMoney(amount, out, MONEY_TEXT_MAX));
+    }
+
+public:
+    HorseRacingGame(SDL_Window* window, SDL_Renderer* renderer, int numHorses = DEFAULT_HORSES) :
+        window(window),
+        renderer(renderer),
+        gameState(std::max(1, std::min(numHorses, MAX_HORSES))),
+        snapshotVersion(0),
+        showProfiler(false),
+        contributionQueue(CONTRIBUTION_QUEUE_CAPACITY),
+        bgm(nullptr),
+        resourcesLoaded(false),
+        raceId(0),
+        raceSeconds(0),
+        raceDuration(0),
+        scrollOffset(0),
+        previousScrollOffset(0),
+        raceElapsed(0),
+        raceTick(0),
+        raceSeed(0),
+        fixedSeed(false),
+        baseSeed(0),
+        recordingRace(false),
+        viewX(0),
+        viewY(0),
+        viewZoom(1.0),
+        inputMode(INPUT_NONE),
+        inputHorse(0),
+        staticLayer(nullptr),
+        frameTexture(nullptr),
+        layersCreated(false),
+        staticLayerValid(false),
+        frameValid(false),
+        drawnSnapshotVersion(0),
+        drawnBackgroundX(0),
+        drawnProfiler(false) {
+        damage.reserve(MAX_DAMAGE_RECTS + 1);
+        int horses = (int)gameState.horseNames.size();
+        gridColumns = std::max(3, (int)std::ceil(std::sqrt((double)horses)));
+
+        // Check for required files before loading
+        CheckRequiredFiles();
+
+        PublishSnapshot();
+
+        // Register every section up front so the CSV header lists them all
+        for (const char* section : {"Update", "DrawUI", "StaticLayer", "DrawContributions", "DrawHorses", "DrawDebugInfo",
+                                    "DrawRaceResult", "DrawText", "RenderText", "Composite", "Present"}) {
+            profiler.Section(section);
+        }
+
+        // Try to load resources
+        resourcesLoaded = LoadResources();
+        if (!resourcesLoaded) {
+            std::cerr << "Failed to load all required resources. Game may not work properly." << std::endl;
+        } else {
+            std::cout << "All resources loaded successfully!" << std::endl;
+        }
+    }
+
+    ~HorseRacingGame() {
+        StopRace();
+        if (bgm) Mix_FreeMusic(bgm);
+        for (auto& reload : assetReloads) {
+            reload.second->done.wait(); // Workers write into the reload
+            if (reload.second->image.surface) SDL_FreeSurface(reload.second->image.surface);
+        }
+        if (staticLayer) SDL_DestroyTexture(staticLayer);
+        if (frameTexture) SDL_DestroyTexture(frameTexture);
+        resources.Release();
+        if(renderer) SDL_DestroyRenderer(renderer);
+        if(window) SDL_DestroyWindow(window);
+    }
+
+    void CheckRequiredFiles() {
+        std::cout << "Checking for required files:" << std::endl;
+        std::cout << "  " << ASSET_PACK_FILE << ": "
+                  << (std::filesystem::exists(ASSET_PACK_FILE) ? "Found (used instead of the files below)" : "Not found (optional)") << std::endl;
+        for (const auto& asset : REQUIRED_ASSETS) {
+            bool exists = std::filesystem::exists(asset.name);
+            std::cout << "  " << asset.name << ": " << (exists ? "Found" : "MISSING") << std::endl;
+        }
+    }
+
+    struct DecodedImage {
+        std::string filename;
+        SDL_Surface* surface;
+        std::string error;
+        double decodeMs;
+    };
+
+    // Decode image files on a pool of worker threads. Only the decode runs off
+    // the main thread; turning the surfaces into textures stays with the renderer.
+    std::vector<DecodedImage> DecodeImages(const std::vector<std::string>& filenames) {
+        std::vector<DecodedImage> images(filenames.size());
+        scheduler.ParallelFor(filenames.size(), [&](size_t i) {
+            auto start = std::chrono::steady_clock::now();
+            images[i].filename = filenames[i];
+            images[i].surface = IMG_Load(filenames[i].c_str());
+            if (!images[i].surface) images[i].error = IMG_GetError();
+            images[i].decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        });
+        return images;
+    }
+
+    // Create a texture from a decoded image and release the surface
+    SDL_Texture* UploadImage(DecodedImage& image) {
+        if (!image.surface) {
+            std::cerr << "Failed to load image: " << image.filename << ", Error: " << image.error << std::endl;
+            return nullptr;
+        }
+        auto start = std::chrono::steady_clock::now();
+        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, image.surface);
+        SDL_FreeSurface(image.surface);
+        image.surface = nullptr;
+        double uploadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (!texture) {
+            std::cerr << "Failed to create texture from surface (" << image.filename << "), Error: " << SDL_GetError() << std::endl;
+            return nullptr;
+        }
+        std::cout << "  " << image.filename << ": decode " << std::fixed << std::setprecision(1) << image.decodeMs
+                  << " ms, upload " << uploadMs << " ms" << std::defaultfloat << std::endl;
+        return texture;
+    }
+
+    // Create a texture straight from pre-scaled RGBA in the mapped pack
+    SDL_Texture* LoadPackedImage(const char* name) {
+        const PackEntry* entry = resources.pack.Find(name);
+        if (!entry || entry->type != PACK_ENTRY_RGBA) {
+            std::cerr << "Asset pack has no image " << name << std::endl;
+            return nullptr;
+        }
+        SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC,
+                                                 entry->width, entry->height);
+        if (!texture || SDL_UpdateTexture(texture, NULL, resources.pack.Data(*entry), entry->width * 4) != 0) {
+            std::cerr << "Failed to create texture from asset pack (" << name << "), Error: " << SDL_GetError() << std::endl;
+            if (texture) SDL_DestroyTexture(texture);
+            return nullptr;
+        }
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        // Portraits are packed for the largest zoom and shrunk below it
+        SDL_SetTextureScaleMode(texture, SDL_ScaleModeLinear);
+        return texture;
+    }
+
+    bool LoadPackedImages() {
+        bool success = true;
+        auto start = std::chrono::steady_clock::now();
+
+        resources.bgImage = LoadPackedImage("0.png");
+        if (!resources.bgImage) success = false;
+
+        for (int i = 1; i <= HORSE_SPRITES; i++) {
+            SDL_Texture* texture = LoadPackedImage((std::to_string(i) + ".png").c_str());
+            if (!texture) success = false;
+            resources.horseImages.push_back(texture);
+        }
+
+        resources.girlImage = LoadPackedImage("7.png");
+        if (!resources.girlImage) success = false;
+
+        std::cout << "Loaded images from " << ASSET_PACK_FILE << " in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()
+                  << " ms" << std::endl;
+        return success;
+    }
+
+    bool LoadImageFiles() {
+        bool success = true;
+
+        // 0.png is the background, 1-6.png the horses, 7.png the girl
+        auto decodeStart = std::chrono::steady_clock::now();
+        std::vector<DecodedImage> images = DecodeImages({
+            "0.png", "1.png", "2.png", "3.png", "4.png", "5.png", "6.png", "7.png"
+        });
+        std::cout << "Decoded " << images.size() << " images in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - decodeStart).count()
+                  << " ms" << std::endl;
+
+        // Load background image
+        resources.bgImage = UploadImage(images[0]);
+        if (!resources.bgImage) success = false;
+
+        // Load horse images; a failed one leaves a nullptr placeholder to maintain index integrity
+        for (int i = 1; i <= HORSE_SPRITES; i++) {
+            SDL_Texture* texture = UploadImage(images[i]);
+            if (!texture) success = false;
+            resources.horseImages.push_back(texture);
+        }
+
+        // Load girl image
+        resources.girlImage = UploadImage(images[7]);
+        if (!resources.girlImage) success = false;
+
+        return success;
+    }
+
+    bool LoadResources() {
+        bool success;
+        if (resources.pack.Open(ASSET_PACK_FILE)) {
+            success = LoadPackedImages();
+        } else {
+            success = LoadImageFiles();
+        }
+
+        // Load font
+        const PackEntry* fontEntry = resources.pack.Find(FONT_FILE);
+        if (fontEntry) {
+            SDL_RWops* rw = SDL_RWFromConstMem(resources.pack.Data(*fontEntry), (int)fontEntry->size);
+            resources.font = TTF_OpenFontRW(rw, 1, FONT_SIZE);
+        } else {
+            resources.font = TTF_OpenFont(FONT_FILE, FONT_SIZE);
+        }
+        if (!resources.font) {
+            std::cerr << "Failed to load font: " << FONT_FILE << ", Error: " << TTF_GetError() << std::endl;
+            success = false;
+        } else {
+            resources.textAtlas = new GlyphAtlas(renderer, resources.font);
+        }
+
+        // Load BGM once; races only start and stop it. Missing music is not fatal.
+        const PackEntry* bgmEntry = resources.pack.Find("race_bgm.mp3");
+        if (bgmEntry) {
+            bgm = Mix_LoadMUS_RW(SDL_RWFromConstMem(resources.pack.Data(*bgmEntry), (int)bgmEntry->size), 1);
+        } else {
+            bgm = Mix_LoadMUS("race_bgm.mp3");
+        }
+        if (bgm == NULL) {
+            std::cerr << "Failed to load music: race_bgm.mp3, Error: " << Mix_GetError() << std::endl;
+        }
+
+        return success;
+    }
+
+    void StartRace() {
+        if (!resourcesLoaded) {
+            std::cout << "リソースの読み込みに失敗しているため、レースを開始できません。" << std::endl;
+            return;
+        }
+
+        if (gameState.isRacing) {
+            std::cout << "レース中です！途中で止めると無効になります。" << std::endl;
+            return;
+        }
+
+        std::cout << "レースが始まります！最後まで推しを信じて貢ぎましょう！" << std::endl;
+        gameState.isRacing = true;
+        gameState.raceFinished = false;
+        raceElapsed = 0;
+        raceTick = 0;
+        PublishSnapshot();
+
+        // Seed the simulation; the seed alone reproduces every simulated contribution
+        raceId++;
+        raceSeed = fixedSeed ? baseSeed + raceId - 1 : ((uint64_t)std::random_device{}() << 32) ^ std::random_device{}();
+        raceSimulator.Start(raceSeed, HorseCount());
+        std::cout << "Race seed: " << raceSeed << std::endl;
+        if (!recordDirectory.empty()) {
+            recording = RaceRecording();
+            recording.numHorses = HorseCount();
+            recording.seed = raceSeed;
+            recording.tickSeconds = 1.0 / DEFAULT_TICK_RATE; // Replaced by the real tick length on the first tick
+            recording.initial = gameState.contributions;
+            recordingRace = true;
+        }
+
+        // Play BGM
+        if (bgm == NULL) {
+            std::cout << "音楽なしでレースを続行します。" << std::endl;
+        } else if (Mix_PlayMusic(bgm, -1) == -1) {
+            std::cerr << "Failed to play music, Error: " << Mix_GetError() << std::endl;
+        }
+
+        // Update() ends the race once this much game time has passed
+        raceDuration = RaceDurationSeconds();
+    }
+
+    // Seed races with seed, seed + 1, ... instead of random seeds
+    void SetRaceSeed(uint64_t seed) {
+        fixedSeed = true;
+        baseSeed = seed;
+    }
+
+    // Write a recording of every race to directory
+    void SetRecordDirectory(const std::string& directory) {
+        recordDirectory = directory;
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        if (error) {
+            std::cerr << "Failed to create " << directory << ": " << error.message() << std::endl;
+        }
+    }
+
+    // Set the race length in seconds; 0 uses the length of the BGM track
+    void SetRaceSeconds(double seconds) {
+        raceSeconds = seconds;
+    }
+
+    double RaceDurationSeconds() const {
+        if (raceSeconds > 0) return raceSeconds;
+#if SDL_MIXER_VERSION_ATLEAST(2, 6, 0)
+        if (bgm) {
+            double trackSeconds = Mix_MusicDuration(bgm);
+            if (trackSeconds > 0) return trackSeconds;
+        }
+#endif
+        return DEFAULT_RACE_SECONDS;
+    }
+
+    void StopRace() {
+        if (!gameState.isRacing.exchange(false)) return;
+
+        if (bgm != NULL) {
+            Mix_HaltMusic();
+        }
+
+        // Everything sent before the race ended counts towards it
+        while (ApplyQueuedContributions(CONTRIBUTION_BATCH)) {}
+        RecordRaceResult();
+        PublishSnapshot();
+        if (recordingRace) {
+            WriteRecording();
+        }
+    }
+
+    // Queue a contribution without asking; applied on the next tick.
+    // Safe from any thread. Returns false if the queue is full.
+    bool Contribute(int horseIndex, long long amount = CONTRIBUTION_AMOUNT) {
+        if (horseIndex < 0 || horseIndex >= HorseCount()) return false;
+        ContributionCommand command = {horseIndex, amount};
+        if (!contributionQueue.TryPush(command)) {
+            std::cerr << "Contribution queue full; dropped " << FormatMoney(amount) << " for horse " << horseIndex + 1 << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // C key: ask for a horse number in the window
+    void OpenContributionPrompt() {
+        inputMode = INPUT_HORSE_NUMBER;
+        inputDigits.clear();
+    }
+
+    // Contribute to horse, asking first unless the player opted out
+    void SelectHorse(int horseIndex) {
+        if (horseIndex < 0 || horseIndex >= HorseCount()) return;
+        if (gameState.skipConfirmation) {
+            inputMode = INPUT_NONE;
+            Contribute(horseIndex);
+        } else {
+            inputMode = INPUT_CONFIRM;
+            inputHorse = horseIndex;
+        }
+    }
+
+    // Keys go here first while the prompt is open. Returns true if the key was used.
+    bool HandlePromptKey(SDL_Keycode key) {
+        if (inputMode == INPUT_NONE) return false;
+        if (key == SDLK_ESCAPE || (inputMode == INPUT_CONFIRM && key == SDLK_n)) {
+            inputMode = INPUT_NONE;
+            std::cout << "貢ぎをキャンセルしました。" << std::endl;
+            return true;
+        }
+
+        if (inputMode == INPUT_HORSE_NUMBER) {
+            int digit = -1;
+            if (key >= SDLK_0 && key <= SDLK_9) digit = key - SDLK_0;
+            else if (key >= SDLK_KP_1 && key <= SDLK_KP_9) digit = key - SDLK_KP_1 + 1;
+            else if (key == SDLK_KP_0) digit = 0;
+
+            if (digit >= 0) {
+                if (inputDigits.size() < 6) inputDigits += (char)('0' + digit);
+            } else if (key == SDLK_BACKSPACE) {
+                if (!inputDigits.empty()) inputDigits.pop_back();
+            } else if (key == SDLK_RETURN || key == SDLK_KP_ENTER) {
+                int choice = inputDigits.empty() ? 0 : atoi(inputDigits.c_str());
+                if (choice >= 1 && choice <= HorseCount()) {
+                    SelectHorse(choice - 1);
+                } else {
+                    std::cout << "無効な選択です。1から" << HorseCount() << "の数字を入力してください。" << std::endl;
+                    inputDigits.clear();
+                }
+            }
+            return true;
+        }
+
+        // INPUT_CONFIRM: Y to contribute, A to contribute and stop asking
+        if (key == SDLK_y || key == SDLK_a || key == SDLK_RETURN || key == SDLK_KP_ENTER) {
+            if (key == SDLK_a) gameState.skipConfirmation = true;
+            inputMode = INPUT_NONE;
+            Contribute(inputHorse);
+        }
+        return true;
+    }
+
+    // Left click: a click on a horse in the grid contributes to it. Returns true if one was hit.
+    bool HandleClick(int x, int y) {
+        SDL_Point point = {x, y};
+        if (!SDL_PointInRect(&point, &HORSE_VIEW)) return false;
+        double worldX = viewX + (x - HORSE_VIEW.x) / viewZoom - HORSE_GRID_MARGIN_X;
+        double worldY = viewY + (y - HORSE_VIEW.y) / viewZoom - HORSE_GRID_MARGIN_Y;
+        if (worldX < 0 || worldY < 0) return false;
+        int column = (int)(worldX / HORSE_CELL_WIDTH);
+        int row = (int)(worldY / HORSE_CELL_HEIGHT);
+        if (column >= gridColumns || worldX - column * HORSE_CELL_WIDTH >= HORSE_SPRITE_SIZE ||
+            worldY - row * HORSE_CELL_HEIGHT >= HORSE_SPRITE_SIZE) {
+            return false;
+        }
+        int horse = row * gridColumns + column;
+        if (horse >= HorseCount()) return false;
+        SelectHorse(horse);
+        return true;
+    }
+
+    // Advance the simulation by one fixed tick
+    void Update(double dt) {
+        PROFILE_SCOPE(profiler, "Update");
+        previousScrollOffset = scrollOffset;
+        // Outside contributions first, then the race clock; ReplayRace() relies on this order
+        bool changed = ApplyQueuedContributions(CONTRIBUTION_BATCH);
+        if (gameState.isRacing) {
+            raceTick++;
+            raceElapsed += dt;
+            recording.tickSeconds = dt;
+            raceSimulator.Advance(raceElapsed, [this, &changed](int horseIndex) {
+                AddContribution(horseIndex, CONTRIBUTION_AMOUNT);
+                changed = true;
+            });
+            ScrollBackground(dt);
+            if (raceElapsed >= raceDuration) {
+                gameState.raceFinished = true;
+                StopRace(); // Publishes
+                return;
+            }
+        }
+        if (changed) {
+            PublishSnapshot();
+        }
+    }
+
+    bool IsRacing() const { return gameState.isRacing; }
+    int RacesStarted() const { return raceId; }
+
+    // alpha is how far the display is between the last two ticks (0..1).
+    //
+    // The frame is kept in frameTexture and only the rects whose content
+    // changed are redrawn into it, each under a clip rect so the fill cost is
+    // that of the rect. The horse grid, names and girl image come from
+    // staticLayer, which is rebuilt only when the view or the images change.
+    // A frame where nothing changed costs one copy to the screen.
+    void DrawUI(double alpha = 1.0) {
+        PROFILE_SCOPE(profiler, "DrawUI");
+        if (!layersCreated) CreateLayers();
+        if (!frameTexture) {
+            // No render targets: draw every frame straight to the screen
+            DrawScene(snapshot, alpha, nullptr);
+            {
+                PROFILE_SCOPE(profiler, "Present");
+                SDL_RenderPresent(renderer);
+            }
+            frameArena.Reset();
+            return;
+        }
+
+        damage.clear();
+        if (!staticLayerValid) {
+            RebuildStaticLayer();
+            AddDamage(StaticLayerRect());
+        }
+        FindDamage(snapshot, alpha);
+
+        if (!damage.empty()) {
+            SDL_SetRenderTarget(renderer, frameTexture);
+            for (const SDL_Rect& rect : damage) {
+                DrawScene(snapshot, alpha, &rect);
+            }
+            SDL_RenderSetClipRect(renderer, NULL);
+            SDL_SetRenderTarget(renderer, NULL);
+        }
+
+        {
+            PROFILE_SCOPE(profiler, "Composite");
+            SDL_RenderCopy(renderer, frameTexture, NULL, NULL);
+        }
+        {
+            PROFILE_SCOPE(profiler, "Present");
+            SDL_RenderPresent(renderer);
+        }
+        frameArena.Reset();
+    }
+
+    // Rebuild the cached layers on the next DrawUI(), e.g. after
+    // SDL_RENDER_TARGETS_RESET lost their contents
+    void InvalidateLayers() {
+        staticLayerValid = false;
+        frameValid = false;
+    }
+
+    // Called once at the start of every main loop iteration
+    void BeginFrame() {
+        profiler.BeginFrame();
+        if (assetWatcher.IsWatching()) ReloadChangedAssets();
+    }
+
+    // Reload images and the font when their files in the working directory
+    // change, even if they were first loaded from the asset pack
+    bool WatchAssets() {
+        if (!assetWatcher.Start(".")) return false;
+        std::cout << "Watching asset files for changes" << std::endl;
+        return true;
+    }
+
+    void ToggleProfilerOverlay() {
+        showProfiler = !showProfiler;
+    }
+
+    // Whether frames change on their own; otherwise the main loop can sleep until input
+    bool IsAnimating() const {
+        return gameState.isRacing || showProfiler;
+    }
+
+    // The main loop reports how long each input took to reach the screen
+    void RecordInputLatency(double ms) {
+        profiler.AddInputLatency(ms);
+    }
+
+    // Scroll the horse grid by a distance in screen pixels
+    void PanHorseView(double dx, double dy) {
+        viewX += dx / viewZoom;
+        viewY += dy / viewZoom;
+        ClampHorseView();
+    }
+
+    // Zoom the horse grid, keeping the point under window position (anchorX, anchorY) in place
+    void ZoomHorseView(double factor, int anchorX, int anchorY) {
+        double worldX = viewX + (anchorX - HORSE_VIEW.x) / viewZoom;
+        double worldY = viewY + (anchorY - HORSE_VIEW.y) / viewZoom;
+        viewZoom = std::max(MinHorseZoom(), std::min(viewZoom * factor, HORSE_MAX_ZOOM));
+        viewX = worldX - (anchorX - HORSE_VIEW.x) / viewZoom;
+        viewY = worldY - (anchorY - HORSE_VIEW.y) / viewZoom;
+        ClampHorseView();
+    }
+
+    void ResetHorseView() {
+        viewX = viewY = 0;
+        viewZoom = 1.0;
+        ClampHorseView();
+    }
+
+    int HorseCount() const { return (int)gameState.horseNames.size(); }
+
+    bool OpenProfileCsv(const std::string& path) {
+        return profiler.OpenCsv(path);
+    }
+
+    // Restore the totals and last result from the journal at path, then log
+    // every change to it. Call before the first race.
+    bool OpenJournal(const std::string& path, JournalSync sync, int commitIntervalMs) {
+        std::vector<long long>& contributions = gameState.contributions;
+        std::vector<long long>& previousResults = gameState.previousResults;
+        auto start = std::chrono::steady_clock::now();
+        bool opened = journal.Open(path, HorseCount(), sync, commitIntervalMs, [&](const JournalRecord& record) {
+            if (record.type == JOURNAL_CONTRIBUTION) {
+                if (record.horse >= 0 && record.horse < HorseCount()) contributions[record.horse] += record.amount;
+            } else if (record.type == JOURNAL_RACE_RESULT) {
+                previousResults = contributions;
+            }
+        });
+        if (!opened) return false;
+
+        // Rank once after the replay instead of once per record
+        gameState.standings.Rebuild(contributions);
+        gameState.results.Rebuild(previousResults);
+        gameState.resultsVersion++;
+        gameState.odds.Rebuild(contributions);
+        PublishSnapshot();
+        std::cout << "Replayed " << journal.ReplayedRecords() << " journal records from " << path << " in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()
+                  << " ms" << std::endl;
+        return true;
+    }
+
+    // Append every race result to path, which keeps them across runs
+    bool OpenHistory(const std::string& path) {
+        if (!history.Open(path, HorseCount())) return false;
+        std::cout << "Recording results to " << path << " (" << history.RaceCount() << " races so far)" << std::endl;
+        return true;
+    }
+
+    // Win rate, contributions and streaks over the whole history for the
+    // listed horses (all of a small field, the current leaders of a large one)
+    void PrintHistory(std::ostream& out) {
+        if (!history.IsOpen()) {
+            out << "No race history; start with --history FILE" << std::endl;
+            return;
+        }
+        size_t horses[CONTRIBUTION_LIST_MAX];
+        int count = gameState.standings.Top(horses, CONTRIBUTION_LIST_MAX);
+        if (HorseCount() <= CONTRIBUTION_LIST_MAX) {
+            for (int i = 0; i < count; i++) horses[i] = i;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        HorseHistory stats[CONTRIBUTION_LIST_MAX];
+        for (int i = 0; i < count; i++) stats[i] = history.ScanHorse((int)horses[i]);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        out << "History: " << history.RaceCount() << " races (scanned in " << std::fixed << std::setprecision(2) << ms << " ms)" << std::endl;
+        for (int i = 0; i < count; i++) {
+            const HorseHistory& horse = stats[i];
+            out << "  " << std::left << std::setw(12) << gameState.horseNames[horses[i]] << std::right
+                << " wins " << std::setprecision(1) << std::setw(5) << 100.0 * horse.WinRate() << "%"
+                << ", avg " << FormatMoney((long long)horse.AverageContribution())
+                << ", best streak " << horse.longestStreak << ", streak " << horse.currentStreak
+                << ", since win " << horse.racesSinceWin << std::endl;
+        }
+        out << std::defaultfloat;
+    }
+
+    // Frame time percentiles and section averages over the profiler history
+    void PrintFrameStats(std::ostream& out) {
+        out << std::fixed << std::setprecision(3)
+            << "Frame ms: p50 " << profiler.FramePercentile(50) << ", p95 " << profiler.FramePercentile(95)
+            << ", p99 " << profiler.FramePercentile(99) << " (last " << profiler.FrameCount() << " frames)" << std::endl;
+        if (profiler.InputLatencyCount() > 0) {
+            out << "Input to present ms: p50 " << profiler.InputLatencyPercentile(50) << ", p95 " << profiler.InputLatencyPercentile(95)
+                << ", max " << profiler.InputLatencyPercentile(100) << " (last " << profiler.InputLatencyCount() << " inputs)" << std::endl;
+        }
+        for (int i = 0; i < profiler.SectionCount(); i++) {
+            out << "  " << std::left << std::setw(18) << profiler.SectionName(i) << std::right
+                << std::setw(9) << profiler.SectionAverageMs(i) << " ms" << std::endl;
+        }
+        out << std::defaultfloat;
+    }
+
+private:
+    // Grid size in world pixels: cells, the margins around them and the last row's names
+    double HorseGridWidth() const {
+        return 2 * HORSE_GRID_MARGIN_X + gridColumns * HORSE_CELL_WIDTH - (HORSE_CELL_WIDTH - HORSE_SPRITE_SIZE);
+    }
+
+    double HorseGridHeight() const {
+        int rows = (HorseCount() + gridColumns - 1) / gridColumns;
+        return 2 * HORSE_GRID_MARGIN_Y + rows * HORSE_CELL_HEIGHT - (HORSE_CELL_HEIGHT - HORSE_SPRITE_SIZE) + HORSE_NAME_HEIGHT;
+    }
+
+    // Zoom at which the whole grid fits the view, never above 1
+    double MinHorseZoom() const {
+        return std::min(1.0, std::min(HORSE_VIEW.w / HorseGridWidth(), HORSE_VIEW.h / HorseGridHeight()));
+    }
+
+    void ClampHorseView() {
+        staticLayerValid = false;
+        viewZoom = std::max(MinHorseZoom(), std::min(viewZoom, HORSE_MAX_ZOOM));
+        viewX = std::max(0.0, std::min(viewX, HorseGridWidth() - HORSE_VIEW.w / viewZoom));
+        viewY = std::max(0.0, std::min(viewY, HorseGridHeight() - HORSE_VIEW.h / viewZoom));
+    }
+
+    void ScrollBackground(double dt) {
+        scrollOffset += BG_SCROLL_SPEED * dt;
+
+        // Keep the offsets small; shifting both by one period leaves the picture unchanged
+        const double period = WINDOW_WIDTH * 3.0;
+        if (scrollOffset >= period) {
+            scrollOffset -= period;
+            previousScrollOffset -= period;
+        }
+    }
+
+    struct AssetReload {
+        DecodedImage image;           // The file name and, for images, the decoded surface
+        std::vector<char> fontData;   // The font file
+        std::future<void> done;
+    };
+
+    // Texture an image file replaces, or null if the file is not a reloadable image
+    SDL_Texture** ImageSlot(const std::string& name) {
+        if (name.size() != 5 || name.compare(1, 4, ".png") != 0 || name[0] < '0' || name[0] > '7') return nullptr;
+        int index = name[0] - '0';
+        if (index == 0) return &resources.bgImage;
+        if (index == 7) return &resources.girlImage;
+        if (index - 1 < (int)resources.horseImages.size()) return &resources.horseImages[index - 1];
+        return nullptr;
+    }
+
+    void ReloadChangedAssets() {
+        assetWatcher.Poll(changedAssets, ASSET_SETTLE_MS);
+        for (const std::string& name : changedAssets) {
+            if (!ImageSlot(name) && name != FONT_FILE) continue;
+            if (assetReloads.count(name)) {
+                assetsChangedAgain.insert(name);
+            } else {
+                StartAssetReload(name);
+            }
+        }
+        changedAssets.clear();
+
+        for (auto it = assetReloads.begin(); it != assetReloads.end();) {
+            if (it->second->done.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                ++it;
+                continue;
+            }
+            std::string name = it->first;
+            FinishAssetReload(*it->second);
+            it = assetReloads.erase(it);
+            if (assetsChangedAgain.erase(name)) StartAssetReload(name);
+        }
+    }
+
+    // Decode (images) or read (the font) on a worker; nothing here touches the renderer
+    void StartAssetReload(const std::string& name) {
+        std::unique_ptr<AssetReload> reload(new AssetReload());
+        AssetReload* job = reload.get();
+        job->image.filename = name;
+        job->image.surface = nullptr;
+        job->image.decodeMs = 0;
+        bool font = name == FONT_FILE;
+        job->done = scheduler.Submit([job, font]() {
+            auto start = std::chrono::steady_clock::now();
+            if (font) {
+                std::ifstream file(job->image.filename, std::ios::binary);
+                job->fontData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+                if (!file.good() && !file.eof()) job->image.error = "read failed";
+                if (job->fontData.empty()) job->image.error = "empty or unreadable file";
+            } else {
+                job->image.surface = IMG_Load(job->image.filename.c_str());
+                if (!job->image.surface) job->image.error = IMG_GetError();
+            }
+            job->image.decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        });
+        assetReloads[name] = std::move(reload);
+    }
+
+    // Swap the reloaded asset in; a file that fails to load leaves the old one in place
+    void FinishAssetReload(AssetReload& reload) {
+        const std::string& name = reload.image.filename;
+        if (SDL_Texture** slot = ImageSlot(name)) {
+            SDL_Texture* texture = UploadImage(reload.image);
+            if (!texture) return;
+            if (*slot) SDL_DestroyTexture(*slot);
+            *slot = texture;
+        } else {
+            if (!reload.image.error.empty()) {
+                std::cerr << "Failed to reload font: " << name << ", Error: " << reload.image.error << std::endl;
+                return;
+            }
+            SDL_RWops* rw = SDL_RWFromConstMem(reload.fontData.data(), (int)reload.fontData.size());
+            TTF_Font* font = TTF_OpenFontRW(rw, 1, FONT_SIZE);
+            if (!font) {
+                std::cerr << "Failed to reload font: " << name << ", Error: " << TTF_GetError() << std::endl;
+                return;
+            }
+            // The atlas caches glyphs of the old font
+            delete resources.textAtlas;
+            if (resources.font) TTF_CloseFont(resources.font);
+            resources.font = font;
+            resources.fontData.swap(reload.fontData); // Same buffer, so font stays valid
+            resources.textAtlas = new GlyphAtlas(renderer, font);
+        }
+        std::cout << "Reloaded " << name << std::endl;
+        InvalidateLayers();
+
+        // A file that was missing at startup may complete the set
+        if (!resourcesLoaded && resources.bgImage && resources.girlImage && resources.font &&
+            std::all_of(resources.horseImages.begin(), resources.horseImages.end(), [](SDL_Texture* t) { return t != nullptr; })) {
+            resourcesLoaded = true;
+        }
+    }
+
+    void CreateLayers() {
+        layersCreated = true;
+        if (!SDL_RenderTargetSupported(renderer)) return;
+        staticLayer = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, WINDOW_WIDTH, WINDOW_HEIGHT);
+        frameTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, WINDOW_WIDTH, WINDOW_HEIGHT);
+        if (!staticLayer || !frameTexture) {
+            std::cerr << "Failed to create layer textures, drawing without them. Error: " << SDL_GetError() << std::endl;
+            if (staticLayer) SDL_DestroyTexture(staticLayer);
+            if (frameTexture) SDL_DestroyTexture(frameTexture);
+            staticLayer = frameTexture = nullptr;
+            return;
+        }
+        SDL_SetTextureBlendMode(staticLayer, SDL_BLENDMODE_BLEND);
+        InvalidateLayers();
+    }
+
+    // Part of the window covered by the static layer
+    static SDL_Rect StaticLayerRect() {
+        SDL_Rect rect;
+        SDL_UnionRect(&HORSE_VIEW, &GIRL_RECT, &rect);
+        return rect;
+    }
+
+    void RebuildStaticLayer() {
+        PROFILE_SCOPE(profiler, "StaticLayer");
+        SDL_SetRenderTarget(renderer, staticLayer);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+        SDL_RenderClear(renderer);
+        DrawStaticContent();
+        SDL_SetRenderTarget(renderer, NULL);
+        staticLayerValid = true;
+    }
+
+    void DrawStaticContent() {
+        DrawHorses();
+        if (resources.girlImage) {
+            SDL_RenderCopy(renderer, resources.girlImage, NULL, &GIRL_RECT);
+        }
+    }
+
+    void AddDamage(const SDL_Rect& rect) {
+        for (SDL_Rect& existing : damage) {
+            if (SDL_HasIntersection(&existing, &rect)) {
+                SDL_UnionRect(&existing, &rect, &existing);
+                return;
+            }
+        }
+        damage.push_back(rect);
+        if (damage.size() > MAX_DAMAGE_RECTS) {
+            SDL_Rect bounds = damage[0];
+            for (const SDL_Rect& other : damage) SDL_UnionRect(&bounds, &other, &bounds);
+            damage.assign(1, bounds);
+        }
+    }
+
+    // Compare what frameTexture shows with what this frame should show
+    void FindDamage(const GameSnapshot& snapshot, double alpha) {
+        const SDL_Rect window = {0, 0, WINDOW_WIDTH, WINDOW_HEIGHT};
+        long backgroundX = std::lround(BackgroundOffset(alpha));
+        if (!frameValid || backgroundX != drawnBackgroundX) {
+            // Everything sits on the background
+            damage.assign(1, window);
+            frameValid = true;
+        }
+        drawnBackgroundX = backgroundX;
+
+        if (snapshot.version != drawnSnapshotVersion) {
+            AddDamage(CONTRIBUTIONS_RECT);
+            AddDamage(RESULT_RECT);
+            drawnSnapshotVersion = snapshot.version;
+        }
+        FrameText debugText = DebugText(snapshot);
+        if (!debugText.Equals(drawnDebugText)) {
+            AddDamage(DEBUG_INFO_RECT);
+            drawnDebugText.assign(debugText.Data(), debugText.Length());
+        }
+        FrameText prompt(frameArena, FRAME_TEXT_MAX);
+        if (inputMode != INPUT_NONE) {
+            prompt.AppendNumber(inputMode).Append(inputDigits).Append("/").AppendNumber(inputHorse);
+        }
+        if (!prompt.Equals(drawnPrompt)) {
+            AddDamage(PROMPT_RECT);
+            drawnPrompt.assign(prompt.Data(), prompt.Length());
+        }
+        if (showProfiler || drawnProfiler) {
+            AddDamage(ProfilerPanelRect()); // The graph moves every frame
+            drawnProfiler = showProfiler;
+        }
+    }
+
+    double BackgroundOffset(double alpha) const {
+        return previousScrollOffset + (scrollOffset - previousScrollOffset) * alpha;
+    }
+
+    // Draw the whole scene, clipped to clip if set, to the current target
+    void DrawScene(const GameSnapshot& snapshot, double alpha, const SDL_Rect* clip) {
+        SDL_RenderSetClipRect(renderer, clip);
+
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        if (clip) {
+            SDL_RenderFillRect(renderer, clip);
+        } else {
+            SDL_RenderClear(renderer);
+        }
+
+        // Draw background if texture exists
+        if (resources.bgImage) {
+            // Three copies side by side, wrapping around a 3-screen-wide strip
+            const double period = WINDOW_WIDTH * 3.0;
+            double offset = BackgroundOffset(alpha);
+            for (int i = 0; i < 3; i++) {
+                double x = std::fmod(i * WINDOW_WIDTH - offset, period);
+                if (x <= -WINDOW_WIDTH) x += period;
+                if (x > WINDOW_WIDTH * 2) x -= period;
+                SDL_Rect bgRect = {(int)std::lround(x), 0, WINDOW_WIDTH, WINDOW_HEIGHT};
+                SDL_RenderCopy(renderer, resources.bgImage, NULL, &bgRect);
+            }
+        } else {
+            // Draw a fallback background if texture is missing
+            SDL_SetRenderDrawColor(renderer, 100, 149, 237, 255); // Cornflower blue
+            SDL_Rect bgRect = {0, 0, WINDOW_WIDTH, WINDOW_HEIGHT};
+            SDL_RenderFillRect(renderer, &bgRect);
+        }
+
+        // Draw horse contributions
+        DrawContributions(snapshot);
+
+        // Horse images, names and the girl image
+        if (staticLayer) {
+            SDL_Rect layerRect = StaticLayerRect();
+            SDL_RenderCopy(renderer, staticLayer, &layerRect, &layerRect);
+        } else {
+            DrawStaticContent();
+        }
+        SDL_RenderSetClipRect(renderer, clip); // DrawHorses() resets the clip rect
+
+        // Draw simple debug text
+        DrawDebugInfo(snapshot);
+
+        // Draw race result
+        if (!snapshot.isRacing && snapshot.raceFinished) {
+            DrawRaceResult(snapshot);
+        }
+
+        if (inputMode != INPUT_NONE) {
+            DrawContributionPrompt();
+        }
+
+        if (showProfiler) {
+            DrawProfilerOverlay();
+        }
+    }
+
+    void WriteRecording() {
+        recordingRace = false;
+        recording.endTick = raceTick;
+        recording.prize = gameState.results.Prize(gameState.previousResults);
+        recording.totalsHash = HashTotals(gameState.previousResults);
+
+        char name[64];
+        std::time_t now = std::time(nullptr);
+        size_t length = std::strftime(name, sizeof(name), "race_%Y%m%d-%H%M%S", std::localtime(&now));
+        snprintf(name + length, sizeof(name) - length, "_%d.eqr", raceId);
+        std::string path = (std::filesystem::path(recordDirectory) / name).string();
+        if (WriteRaceRecording(path, recording)) {
+            std::cout << "Recorded race to " << path << std::endl;
+        }
+        recording.contributions.clear();
+    }
+
+    void RecordRaceResult() {
+        // Store results along with their ranking; the prize is derived from both
+        for (size_t i = 0; i < gameState.horseNames.size(); ++i) {
+            gameState.previousResults[i] = gameState.contributions[i];
+        }
+        gameState.results = gameState.standings;
+        gameState.resultsVersion++;
+        if (journal.IsOpen()) journal.Checkpoint(gameState.contributions, gameState.previousResults);
+        if (history.IsOpen()) AppendHistory();
+    }
+
+    // Add the race that just ended to the history. Each placed horse is paid
+    // its contribution, scaled down like the prize when that is capped.
+    void AppendHistory() {
+        const std::vector<long long>& results = gameState.previousResults;
+        const Leaderboard& ranking = gameState.results;
+        historyFinish.resize(results.size());
+        historyPayouts.assign(results.size(), 0);
+        for (size_t horse = 0; horse < results.size(); horse++) historyFinish[horse] = (uint32_t)ranking.PlaceOf(horse);
+
+        size_t places[PRIZE_PLACES];
+        long long shares[PRIZE_PLACES];
+        int placeCount = ranking.Top(places, PRIZE_PLACES);
+        PrizeShares(results, places, placeCount, shares);
+        for (int i = 0; i < placeCount; i++) historyPayouts[places[i]] = shares[i];
+
+        RaceHistoryRow row;
+        row.timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        row.seed = raceSeed;
+        row.prize = ranking.Prize(results);
+        row.contributions = results.data();
+        row.payouts = historyPayouts.data();
+        row.finish = historyFinish.data();
+        history.Append(row);
+    }
+
+    // Contributions while waiting; live odds from the pool during the race.
+    // Either way only the listed horses are looked at.
+    void DrawContributions(const GameSnapshot& snapshot) {
+        PROFILE_SCOPE(profiler, "DrawContributions");
+        int y = 10;
+        int x = 10;
+        SDL_Color color = {255, 255, 255, 255};
+        FrameText contributionsText(frameArena, FRAME_TEXT_MAX);
+        contributionsText.Append(snapshot.isRacing ? "オッズ:" : "現在の貢ぎ額:");
+
+        int count = snapshot.shownCount;
+        for (int i = 0; i < count; i++) {
+            long long amount = snapshot.shownAmounts[i];
+            contributionsText.Append(gameState.horseNames[snapshot.shown[i]]).Append(": ");
+            if (!snapshot.isRacing) {
+                AppendMoney(contributionsText, amount);
+            } else if (amount > 0) {
+                contributionsText.AppendDecimal(snapshot.odds.Odds(amount), 1).Append("倍");
+            } else {
+                contributionsText.Append("-");
+            }
+            if (i < count - 1) {
+                contributionsText.Append(", ");
+            }
+        }
+        if (HorseCount() > count) {
+            contributionsText.Append(" 他").AppendNumber(HorseCount() - count).Append("頭");
+        }
+        DrawText(contributionsText, x, y, color);
+    }
+    
+    void DrawRaceResult(const GameSnapshot& snapshot) {
+        PROFILE_SCOPE(profiler, "DrawRaceResult");
+        // Draw race result on screen
+        int y = 400;
+        int x = 10;
+        SDL_Color color = {255, 255, 255, 255};
+        
+        // Leading horses by contribution, ranked when the race ended
+        const size_t* indices = snapshot.winners;
+        int places = snapshot.winnerCount;
+        
+        // Display results
+        DrawText("🏆レース結果🏆", x, y, color);
+        y += 30;
+        for (int i = 0; i < places; i++) {
+            FrameText resultText(frameArena, FRAME_TEXT_MAX);
+            resultText.AppendNumber(i + 1).Append("位: ").Append(gameState.horseNames[indices[i]]).Append(" - ");
+            AppendMoney(resultText, snapshot.winnerAmounts[i]);
+            DrawText(resultText, x, y, color);
+            y += 30;
+        }
+        
+        long long totalPrize = snapshot.prize;
+
+        FrameText prizeText(frameArena, FRAME_TEXT_MAX);
+        prizeText.Append("✨獲得賞金: ");
+        AppendMoney(prizeText, totalPrize);
+        prizeText.Append("✨");
+        DrawText(prizeText, x, y, color);
+    }
+
+    static void AddQuad(std::vector<SDL_Vertex>& batch, float x, float y, float size, SDL_Color color) {
+        SDL_Vertex vertex;
+        vertex.color = color;
+        for (int corner = 0; corner < 4; corner++) {
+            float u = (float)(corner & 1), v = (float)(corner >> 1);
+            vertex.position.x = x + u * size;
+            vertex.position.y = y + v * size;
+            vertex.tex_coord.x = u;
+            vertex.tex_coord.y = v;
+            batch.push_back(vertex);
+        }
+    }
+
+    // Only the cells inside HORSE_VIEW are visited. Their sprites are gathered
+    // into one batch per texture and drawn with a single SDL_RenderGeometry call
+    // each, so the number of draw calls does not grow with the field.
+    void DrawHorses() {
+        PROFILE_SCOPE(profiler, "DrawHorses");
+        const int horses = HorseCount();
+        const int rows = (horses + gridColumns - 1) / gridColumns;
+        const float cellSize = (float)(HORSE_SPRITE_SIZE * viewZoom);
+
+        // Visible cell range, one extra on each side for names wider than their cell
+        double left = viewX - HORSE_GRID_MARGIN_X, top = viewY - HORSE_GRID_MARGIN_Y;
+        int firstColumn = std::max(0, (int)std::floor(left / HORSE_CELL_WIDTH) - 1);
+        int lastColumn = std::min(gridColumns - 1, (int)((left + HORSE_VIEW.w / viewZoom) / HORSE_CELL_WIDTH) + 1);
+        int firstRow = std::max(0, (int)std::floor(top / HORSE_CELL_HEIGHT) - 1);
+        int lastRow = std::min(rows - 1, (int)((top + HORSE_VIEW.h / viewZoom) / HORSE_CELL_HEIGHT) + 1);
+
+        for (auto& batch : horseBatches) batch.clear();
+        SDL_Color white = {255, 255, 255, 255};
+        SDL_Color placeholder = {200, 100, 100, 255};
+        for (int row = firstRow; row <= lastRow; row++) {
+            float y = (float)(HORSE_VIEW.y + (HORSE_GRID_MARGIN_Y + row * HORSE_CELL_HEIGHT - viewY) * viewZoom);
+            for (int column = firstColumn; column <= lastColumn; column++) {
+                int horse = row * gridColumns + column;
+                if (horse >= horses) break;
+                float x = (float)(HORSE_VIEW.x + (HORSE_GRID_MARGIN_X + column * HORSE_CELL_WIDTH - viewX) * viewZoom);
+                int sprite = gameState.horseSprites[horse];
+                if (sprite < (int)resources.horseImages.size() && resources.horseImages[sprite]) {
+                    AddQuad(horseBatches[sprite], x, y, cellSize, white);
+                } else {
+                    // Placeholder if texture is missing
+                    AddQuad(horseBatches[HORSE_SPRITES], x, y, cellSize, placeholder);
+                }
+            }
+        }
+
+        size_t maxQuads = 0;
+        for (const auto& batch : horseBatches) maxQuads = std::max(maxQuads, batch.size() / 4);
+        for (size_t quad = quadIndices.size() / 6; quad < maxQuads; quad++) {
+            int base = (int)quad * 4;
+            for (int corner : {0, 1, 2, 2, 1, 3}) quadIndices.push_back(base + corner);
+        }
+
+        SDL_RenderSetClipRect(renderer, &HORSE_VIEW);
+        for (int i = 0; i <= HORSE_SPRITES; i++) {
+            const std::vector<SDL_Vertex>& batch = horseBatches[i];
+            if (batch.empty()) continue;
+            SDL_Texture* texture = i < HORSE_SPRITES && i < (int)resources.horseImages.size() ? resources.horseImages[i] : NULL;
+            SDL_RenderGeometry(renderer, texture, batch.data(), (int)batch.size(),
+                               quadIndices.data(), (int)(batch.size() / 4 * 6));
+        }
+
+        // Draw horse names below the images while they are still readable
+        if (viewZoom >= HORSE_NAME_MIN_ZOOM && resources.textAtlas) {
+            for (int row = firstRow; row <= lastRow; row++) {
+                int y = (int)(HORSE_VIEW.y + (HORSE_GRID_MARGIN_Y + row * HORSE_CELL_HEIGHT - viewY) * viewZoom + cellSize);
+                for (int column = firstColumn; column <= lastColumn; column++) {
+                    int horse = row * gridColumns + column;
+                    if (horse >= horses) break;
+                    int x = (int)(HORSE_VIEW.x + (HORSE_GRID_MARGIN_X + column * HORSE_CELL_WIDTH - viewX) * viewZoom);
+                    int width = resources.textAtlas->MeasureText(gameState.horseNames[horse]).x;
+                    DrawText(gameState.horseNames[horse], x + ((int)cellSize - width) / 2, y, white);
+                }
+            }
+        }
+        SDL_RenderSetClipRect(renderer, NULL);
+    }
+
+    FrameText DebugText(const GameSnapshot& snapshot) {
+        FrameText text(frameArena, FRAME_TEXT_MAX);
+        if (!snapshot.isRacing) {
+            text.Append("ゲーム状態: 待機中 | スペースキーでレース開始 | Cキーで馬に貢ぐ | ESCで終了");
+        } else {
+            text.Append("ゲーム状態: レース中... ").AppendNumber((int)raceElapsed).Append("秒");
+        }
+        return text;
+    }
+
+    void DrawDebugInfo(const GameSnapshot& snapshot) {
+        PROFILE_SCOPE(profiler, "DrawDebugInfo");
+        // Draw debug info on screen
+        int y = DEBUG_INFO_RECT.y;
+        int x = 10;
+        SDL_Color color = {255, 255, 255, 255};
+        DrawText(DebugText(snapshot), x, y, color);
+    }
+
+    void DrawContributionPrompt() {
+        FrameText question(frameArena, FRAME_TEXT_MAX);
+        const char* help;
+        if (inputMode == INPUT_HORSE_NUMBER) {
+            question.Append("どの馬に貢ぎますか？ 番号 (1-").AppendNumber(HorseCount()).Append("): ").Append(inputDigits).Append("_");
+            help = "Enterで決定 / Escで取消 / 馬をクリックしても選べます";
+        } else {
+            question.Append("本当に").Append(gameState.horseNames[inputHorse]).Append("に");
+            AppendMoney(question, CONTRIBUTION_AMOUNT);
+            question.Append("を貢ぎますか？");
+            help = "Y: はい / N: いいえ / A: はい (次回から確認しない)";
+        }
+
+        int width = 0;
+        if (resources.textAtlas) {
+            width = std::max(resources.textAtlas->MeasureText(question.Data(), question.Length()).x,
+                             resources.textAtlas->MeasureText(help, strlen(help)).x);
+        }
+        SDL_Rect panel = {10, 50, width + 20, 80};
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 200);
+        SDL_RenderFillRect(renderer, &panel);
+
+        SDL_Color color = {255, 255, 255, 255};
+        SDL_Color helpColor = {200, 200, 200, 255};
+        DrawText(question, panel.x + 10, panel.y + 8, color);
+        DrawText(help, panel.x + 10, panel.y + 42, helpColor);
+    }
+
+    // Frame time graph and per-section averages over the profiler history
+    static const int PROFILER_GRAPH_HEIGHT = 100;
+    static const int PROFILER_ROW_HEIGHT = 26;
+
+    SDL_Rect ProfilerPanelRect() const {
+        int rows = 2 + profiler.SectionCount();
+        SDL_Rect panel = {WINDOW_WIDTH - 420, 10, 410, PROFILER_GRAPH_HEIGHT + 20 + rows * PROFILER_ROW_HEIGHT};
+        return panel;
+    }
+
+    void DrawProfilerOverlay() {
+        SDL_Rect panel = ProfilerPanelRect();
+        const int panelX = panel.x;
+        const int panelY = panel.y;
+        const int graphHeight = PROFILER_GRAPH_HEIGHT;
+        const double graphScaleMs = 50.0; // Full graph height
+        const int rowHeight = PROFILER_ROW_HEIGHT;
+
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 180);
+        SDL_RenderFillRect(renderer, &panel);
+
+        // 16.7 ms budget line, then one point per frame, newest on the right
+        int graphBottom = panelY + 10 + graphHeight;
+        int budgetY = graphBottom - (int)(16.7 / graphScaleMs * graphHeight);
+        SDL_SetRenderDrawColor(renderer, 255, 80, 80, 255);
+        SDL_RenderDrawLine(renderer, panelX + 5, budgetY, panelX + 5 + FrameProfiler::HISTORY, budgetY);
+
+        SDL_Point points[FrameProfiler::HISTORY];
+        int count = profiler.FrameCount();
+        for (int i = 0; i < count; i++) {
+            double ms = std::min(profiler.FrameMs(count - 1 - i), graphScaleMs);
+            points[i].x = panelX + 5 + FrameProfiler::HISTORY - count + i;
+            points[i].y = graphBottom - (int)(ms / graphScaleMs * graphHeight);
+        }
+        SDL_SetRenderDrawColor(renderer, 80, 255, 80, 255);
+        if (count > 1) SDL_RenderDrawLines(renderer, points, count);
+
+        SDL_Color color = {255, 255, 255, 255};
+        int y = graphBottom + 10;
+        char line[128];
+        snprintf(line, sizeof(line), "frame p50 %.1f  p95 %.1f  p99 %.1f ms",
+                 profiler.FramePercentile(50), profiler.FramePercentile(95), profiler.FramePercentile(99));
+        DrawText(line, panelX + 5, y, color);
+        y += rowHeight;
+        snprintf(line, sizeof(line), "input p50 %.0f  p95 %.0f  max %.0f ms",
+                 profiler.InputLatencyPercentile(50), profiler.InputLatencyPercentile(95), profiler.InputLatencyPercentile(100));
+        DrawText(line, panelX + 5, y, color);
+        for (int i = 0; i < profiler.SectionCount(); i++) {
+            y += rowHeight;
+            snprintf(line, sizeof(line), "%-18s %7.3f ms", profiler.SectionName(i), profiler.SectionAverageMs(i));
+            DrawText(line, panelX + 5, y, color);
+        }
+    }
+};
+
+// Software renderer drawing into a window-sized surface, for running without
+// a display. Free *target only after the renderer has been destroyed.
+inline SDL_Renderer* CreateOffscreenRenderer(SDL_Surface** target) {
+    *target = SDL_CreateRGBSurfaceWithFormat(0, WINDOW_WIDTH, WINDOW_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (!*target) {
+        return nullptr;
+    }
+    SDL_Renderer* renderer = SDL_CreateSoftwareRenderer(*target);
+    if (!renderer) {
+        SDL_FreeSurface(*target);
+        *target = nullptr;
+    }
+    return renderer;
+}
@@ -1,565 +1,187 @@
-#include <SDL.h>
-#include <SDL_image.h>
-#include <SDL_mixer.h>
-#include <SDL_ttf.h>
-#include <string>
-#include <vector>
-#include <random>
-#include <thread>
-#include <chrono>
-#include <memory>
-#include <algorithm>
-#include <iostream>
-#include <iomanip>
-#include <sstream>
-#include <filesystem>
-#include <atomic>
-
-// Game constants
-const int WINDOW_WIDTH = 1250;
-const int WINDOW_HEIGHT = 690;
-const int CONTRIBUTION_AMOUNT = 10000000; // 1000万円
-const std::vector<long long> PRIZE_DISTRIBUTION = {200000000, 100000000, 100000000, 0, 0, 0};
-
-// Game state
-struct GameState {
-    std::vector<std::string> horseNames;
-    std::vector<long long> contributions;
-    std::vector<long long> previousResults;
-    bool isRacing;
-    bool skipConfirmation;
-    std::atomic<bool> raceFinished;
-
-    GameState() :
-        horseNames{"クラウドナイト", "ダンディオン", "ルシフェルウィング",
-                  "アレスフレア", "レオンハート", "ゼウスブレイド"},
-        contributions(6, 0),
-        previousResults(6, 0),
-        isRacing(false),
-        skipConfirmation(false),
-        raceFinished(false) {}
+#include "alloc_counter.h"
+#include "equis_game.h"
+#include "game_clock.h"
+#include <set>
+
+const double HEADLESS_FRAME_SECONDS = 1.0 / 60; // Game time covered by each headless frame by default
+const int IDLE_WAIT_MS = 250;       // Longest sleep while nothing moves, so contributions queued elsewhere still show
+const int FALLBACK_FRAME_MS = 16;   // Frame pacing when the renderer has no vsync
+
+struct HeadlessOptions {
+    bool enabled;
+    int frames;
+    bool startRace;
+    int races;                   // Run races back to back until this many have finished (0 = frames decides)
+    int contributionsPerFrame;   // Scripted contributions to random horses
+    std::set<int> captureFrames;
+    std::string captureDir;
+    int checkAllocationsAfter;   // Warm-up frames before counting heap allocations per frame (-1 = off)
+
+    HeadlessOptions() : enabled(false), frames(600), startRace(false), races(0), contributionsPerFrame(0), captureDir("frames"),
+        checkAllocationsAfter(-1) {}
 };
 
-// UI Resources
-struct UIResources {
-    SDL_Texture* bgImage;
-    std::vector<SDL_Texture*> horseImages;
-    SDL_Texture* girlImage;
-    std::vector<SDL_Texture*> horseNameTextures;
-    int bgX1, bgX2, bgX3;
-    TTF_Font* font;
-
-    UIResources() : bgImage(nullptr), girlImage(nullptr), bgX1(0), bgX2(WINDOW_WIDTH), bgX3(WINDOW_WIDTH * 2), font(nullptr) {}
-    ~UIResources(){
-        if (bgImage) SDL_DestroyTexture(bgImage);
-        for (auto& horseImage : horseImages) {
-            if (horseImage) SDL_DestroyTexture(horseImage);
-        }
-        if (girlImage) SDL_DestroyTexture(girlImage);
-        for (auto& horseNameTexture : horseNameTextures) {
-            if (horseNameTexture) SDL_DestroyTexture(horseNameTexture);
-        }
-        if (font) {
-            TTF_CloseFont(font);
-        }
+// Run the game loop without a display. Every frame advances the game by
+// what clock hands out (a fixed step unless --time-scale was given) and is
+// drawn into the offscreen target; selected frames are saved as PNG.
+// Returns false if --check-allocations found a steady-state frame that
+// allocated.
+static bool RunHeadless(HorseRacingGame& game, SDL_Surface* target, const HeadlessOptions& options, int tickRate, GameClock clock) {
+    if (!options.captureFrames.empty()) {
+        std::filesystem::create_directories(options.captureDir);
     }
-};
-
-class HorseRacingGame {
-private:
-    SDL_Window* window;
-    SDL_Renderer* renderer;
-    GameState gameState;
-    UIResources resources;
-    std::thread raceThread;
-    std::thread backgroundThread;
-    std::thread bgmCheckThread;
-    Mix_Music* bgm;
-    bool resourcesLoaded;
-    bool isRunning;
-
-    // Helper function to render text
-    SDL_Texture* RenderText(const std::string& text, SDL_Color color) {
-        if (!resources.font) {
-            std::cerr << "Error: Font not loaded!" << std::endl;
-            return nullptr;
-        }
-        SDL_Surface* surface = TTF_RenderUTF8_Blended(resources.font, text.c_str(), color);
-        if (!surface) {
-            std::cerr << "Failed to render text: " << TTF_GetError() << std::endl;
-            return nullptr;
-        }
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-        SDL_FreeSurface(surface);
-        return texture;
-    }
-
-public:
-    HorseRacingGame(SDL_Window* window, SDL_Renderer* renderer) :
-        window(window),
-        renderer(renderer),
-        bgm(nullptr),
-        resourcesLoaded(false),
-        isRunning(true) {
-
-        // Check for required files before loading
-        CheckRequiredFiles();
-
-        // Try to load resources
-        resourcesLoaded = LoadResources();
-        if (!resourcesLoaded) {
-            std::cerr << "Failed to load all required resources. Game may not work properly." << std::endl;
-        } else {
-            std::cout << "All resources loaded successfully!" << std::endl;
-        }
-    }
-
-    ~HorseRacingGame() {
-        StopRace();
-        isRunning = false;
-        if (bgmCheckThread.joinable()) bgmCheckThread.join();
-        resources.~UIResources();
-        if(renderer) SDL_DestroyRenderer(renderer);
-        if(window) SDL_DestroyWindow(window);
-    }
-
-    void CheckRequiredFiles() {
-        std::vector<std::string> requiredFiles = {
-            "0.png", "1.png", "2.png", "3.png", "4.png", "5.png", "6.png", "7.png", "race_bgm.mp3", "KaiseiTokumin-Bold.ttf"
-        };
-
-        std::cout << "Checking for required files:" << std::endl;
-        for (const auto& file : requiredFiles) {
-            bool exists = std::filesystem::exists(file);
-            std::cout << "  " << file << ": " << (exists ? "Found" : "MISSING") << std::endl;
-        }
+    if (options.startRace || options.races > 0) {
+        game.StartRace();
     }
 
-    bool LoadResources() {
-        bool success = true;
-
-        // Load background image
-        SDL_Surface* surface = IMG_Load("0.png");
-        if (!surface) {
-            std::cerr << "Failed to load image: 0.png, Error: " << IMG_GetError() << std::endl;
-            success = false;
-        } else {
-            resources.bgImage = SDL_CreateTextureFromSurface(renderer, surface);
-            SDL_FreeSurface(surface);
-            if (!resources.bgImage) {
-                std::cerr << "Failed to create texture from surface (0.png), Error: " << SDL_GetError() << std::endl;
-                success = false;
+    const double tickSeconds = 1.0 / tickRate;
+    double accumulator = 0;
+    RaceRng scriptRng(1);
+    SDL_Event e;
+    int frame = 0;
+    int racesFinished = 0;
+    int allocatingFrames = 0;
+    unsigned long long allocations = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (; options.races > 0 ? racesFinished < options.races : frame < options.frames; frame++) {
+        unsigned long long allocationsBefore = HeapAllocationCount();
+        int racesBefore = game.RacesStarted();
+        bool racingBefore = game.IsRacing();
+        game.BeginFrame();
+        while (SDL_PollEvent(&e) != 0) {}
+
+        for (int i = 0; i < options.contributionsPerFrame; i++) {
+            game.Contribute(PickSimulatedHorse(scriptRng, game.HorseCount()));
+        }
+
+        accumulator += clock.Advance(MAX_FRAME_SECONDS);
+        while (accumulator >= tickSeconds) {
+            game.Update(tickSeconds);
+            accumulator -= tickSeconds;
+            if (options.races > 0 && !game.IsRacing()) {
+                if (++racesFinished < options.races) game.StartRace();
             }
         }
+        game.DrawUI(accumulator / tickSeconds);
 
-        // Load horse images
-        for (int i = 1; i <= 6; i++) {
-            char filename[20];
-            sprintf(filename, "%d.png", i);
-            surface = IMG_Load(filename);
-            if (!surface) {
-                std::cerr << "Failed to load image: " << filename << ", Error: " << IMG_GetError() << std::endl;
-                success = false;
-                resources.horseImages.push_back(nullptr); // Add placeholder to maintain index integrity
-            } else {
-                SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-                SDL_FreeSurface(surface);
-                if (!texture) {
-                    std::cerr << "Failed to create texture from surface (" << filename << "), Error: " << SDL_GetError() << std::endl;
-                    success = false;
-                    resources.horseImages.push_back(nullptr);
-                } else {
-                    resources.horseImages.push_back(texture);
+        // Starting and finishing a race allocate (recordings, journal), so
+        // only frames in between count as steady state
+        bool steady = game.RacesStarted() == racesBefore && game.IsRacing() == racingBefore;
+        if (options.checkAllocationsAfter >= 0 && frame >= options.checkAllocationsAfter && steady) {
+            unsigned long long count = HeapAllocationCount() - allocationsBefore;
+            if (count > 0) {
+                if (allocatingFrames < 10) {
+                    std::cerr << "Frame " << frame << " made " << count << " heap allocations" << std::endl;
                 }
+                allocatingFrames++;
+                allocations += count;
             }
         }
 
-        // Load girl image
-        surface = IMG_Load("7.png");
-        if (!surface) {
-            std::cerr << "Failed to load image: 7.png, Error: " << IMG_GetError() << std::endl;
-            success = false;
-        } else {
-            resources.girlImage = SDL_CreateTextureFromSurface(renderer, surface);
-            SDL_FreeSurface(surface);
-            if (!resources.girlImage) {
-                std::cerr << "Failed to create texture from surface (7.png), Error: " << SDL_GetError() << std::endl;
-                success = false;
-            }
-        }
-        
-        // Load font
-        resources.font = TTF_OpenFont("KaiseiTokumin-Bold.ttf", 24);
-        if (!resources.font) {
-            std::cerr << "Failed to load font: KaiseiTokumin-Bold.ttf, Error: " << TTF_GetError() << std::endl;
-            success = false;
-        }
-        
-        // Load horse name textures
-        SDL_Color textColor = {255, 255, 255, 255};
-        for (const auto& name : gameState.horseNames) {
-            SDL_Texture* nameTexture = RenderText(name, textColor);
-            if (!nameTexture) {
-                std::cerr << "Failed to create texture for horse name: " << name << std::endl;
-                success = false;
-                resources.horseNameTextures.push_back(nullptr);
+        if (options.captureFrames.count(frame)) {
+            char filename[32];
+            snprintf(filename, sizeof(filename), "frame_%05d.png", frame);
+            std::string path = (std::filesystem::path(options.captureDir) / filename).string();
+            if (IMG_SavePNG(target, path.c_str()) != 0) {
+                std::cerr << "Failed to save " << path << ", Error: " << IMG_GetError() << std::endl;
             } else {
-                resources.horseNameTextures.push_back(nameTexture);
+                std::cout << "Captured " << path << std::endl;
             }
         }
-
-        return success;
-    }
-
-    void StartRace() {
-        if (!resourcesLoaded) {
-            std::cout << "リソースの読み込みに失敗しているため、レースを開始できません。" << std::endl;
-            return;
-        }
-
-        if (gameState.isRacing) {
-            std::cout << "レース中です！途中で止めると無効になります。" << std::endl;
-            return;
-        }
-
-        std::cout << "レースが始まります！最後まで推しを信じて貢ぎましょう！" << std::endl;
-        gameState.isRacing = true;
-        gameState.raceFinished = false;
-
-        // Try to load and play BGM
-        bgm = Mix_LoadMUS("race_bgm.mp3");
-        if (bgm == NULL) {
-            std::cerr << "Failed to load music: race_bgm.mp3, Error: " << Mix_GetError() << std::endl;
-            std::cout << "音楽なしでレースを続行します。" << std::endl;
-        } else {
-            if (Mix_PlayMusic(bgm, -1) == -1) {
-                std::cerr << "Failed to play music, Error: " << Mix_GetError() << std::endl;
-            }
-        }
-        
-        // Start BGM check thread
-        bgmCheckThread = std::thread([this]() {
-            while (isRunning) {
-                if (gameState.isRacing && Mix_PlayingMusic() == 0) {
-                    gameState.raceFinished = true;
-                    StopRace();
-                    break;
-                }
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            }
-        });
-
-        // Start background scroll thread
-        try {
-            backgroundThread = std::thread([this]() {
-                while (gameState.isRacing) {
-                    ScrollBackground();
-                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                }
-            });
-        } catch (const std::exception& e) {
-            std::cerr << "Failed to start background thread: " << e.what() << std::endl;
-            gameState.isRacing = false;
-        }
-
-        // Start race simulation thread
-        try {
-            raceThread = std::thread([this]() {
-                SimulateRace();
-            });
-        } catch (const std::exception& e) {
-            std::cerr << "Failed to start race thread: " << e.what() << std::endl;
-            gameState.isRacing = false;
-        }
-    }
-
-    void StopRace() {
-        if (!gameState.isRacing) return;
-        gameState.isRacing = false;
-
-        try {
-            if (backgroundThread.joinable()) backgroundThread.join();
-            if (raceThread.joinable()) raceThread.join();
-        } catch (const std::exception& e) {
-            std::cerr << "Error joining threads: " << e.what() << std::endl;
-        }
-
-        if (bgm != NULL) {
-            Mix_HaltMusic();
-            Mix_FreeMusic(bgm);
-            bgm = nullptr;
-        }
-
-        CalculatePrize();
-    }
-
-    void Contribute(int horseIndex) {
-        if (horseIndex >= 0 && horseIndex < (int)gameState.horseNames.size()) {
-            if (!gameState.skipConfirmation) {
-                std::cout << "本当に" << gameState.horseNames[horseIndex] << "に" << FormatMoney(CONTRIBUTION_AMOUNT) << "を貢ぎますか？(y/n)" << std::endl;
-                char confirm;
-                std::cin >> confirm;
-                if (confirm != 'y') {
-                    std::cout << "貢ぎをキャンセルしました。" << std::endl;
-                    return;
-                }
-                std::cout << "次回から確認を省略しますか？(y/n)" << std::endl;
-                std::cin >> confirm;
-                if (confirm == 'y') {
-                    gameState.skipConfirmation = true;
-                }
-            }
-            gameState.contributions[horseIndex] += CONTRIBUTION_AMOUNT;
-        }
-    }
-
-    void DrawUI() {
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-        SDL_RenderClear(renderer);
-
-        // Draw background if texture exists
-        if (resources.bgImage) {
-            SDL_Rect bgRect = {resources.bgX1, 0, WINDOW_WIDTH, WINDOW_HEIGHT};
-            SDL_RenderCopy(renderer, resources.bgImage, NULL, &bgRect);
-            bgRect = {resources.bgX2, 0, WINDOW_WIDTH, WINDOW_HEIGHT};
-            SDL_RenderCopy(renderer, resources.bgImage, NULL, &bgRect);
-            bgRect = {resources.bgX3, 0, WINDOW_WIDTH, WINDOW_HEIGHT};
-            SDL_RenderCopy(renderer, resources.bgImage, NULL, &bgRect);
-        } else {
-            // Draw a fallback background if texture is missing
-            SDL_SetRenderDrawColor(renderer, 100, 149, 237, 255); // Cornflower blue
-            SDL_Rect bgRect = {0, 0, WINDOW_WIDTH, WINDOW_HEIGHT};
-            SDL_RenderFillRect(renderer, &bgRect);
-        }
-
-        // Draw horse contributions
-        DrawContributions();
-
-        // Draw horse images
-        DrawHorses();
-
-        // Draw girl image if texture exists
-        if (resources.girlImage) {
-            SDL_Rect girlRect = {1020, 510, 150, 150};
-            SDL_RenderCopy(renderer, resources.girlImage, NULL, &girlRect);
-        }
-
-        // Draw simple debug text
-        DrawDebugInfo();
-        
-        // Draw race result
-        if (!gameState.isRacing && gameState.raceFinished) {
-            DrawRaceResult();
-        }
-
-        SDL_RenderPresent(renderer);
-    }
-
-    void ShowContributionDialog() {
-        std::cout << "どの馬に貢ぎますか？" << std::endl;
-        for (size_t i = 0; i < gameState.horseNames.size(); ++i) {
-            std::cout << i + 1 << ". " << gameState.horseNames[i] << std::endl;
-        }
-
-        int choice;
-        std::cout << "番号を入力してください (1-6): ";
-        std::cin >> choice;
-
-        if (choice >= 1 && choice <= (int)gameState.horseNames.size()) {
-            Contribute(choice - 1);
-        } else {
-            std::cout << "無効な選択です。1から6の数字を入力してください。" << std::endl;
-        }
-    }
-
-private:
-    void ScrollBackground() {
-        resources.bgX1 -= 2;
-        resources.bgX2 -= 2;
-        resources.bgX3 -= 2;
-
-        if (resources.bgX1 <= -WINDOW_WIDTH) resources.bgX1 = WINDOW_WIDTH * 2;
-        if (resources.bgX2 <= -WINDOW_WIDTH) resources.bgX2 = WINDOW_WIDTH * 2;
-        if (resources.bgX3 <= -WINDOW_WIDTH) resources.bgX3 = WINDOW_WIDTH * 2;
-    }
-
-    void SimulateRace() {
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<> dis(0, gameState.horseNames.size() - 1);
-
-        int delay = 10;
-        while (gameState.isRacing) {
-            int horseIndex = dis(gen);
-            gameState.contributions[horseIndex] += CONTRIBUTION_AMOUNT;
-
-            delay = std::max(1, delay - 1);
-            std::this_thread::sleep_for(std::chrono::seconds(delay));
-        }
-    }
-
-    void CalculatePrize() {
-        // Sort horses by contribution
-        std::vector<size_t> indices(gameState.horseNames.size());
-        std::iota(indices.begin(), indices.end(), 0);
-        std::sort(indices.begin(), indices.end(),
-                 [this](size_t a, size_t b) {
-                     return gameState.contributions[a] > gameState.contributions[b];
-                 });
-        
-        // Calculate total prize money (max 3億円)
-        long long totalPrize = 0;
-        for (size_t i = 0; i < 3; i++) {
-            totalPrize += gameState.contributions[indices[i]];
-        }
-        totalPrize = std::min(totalPrize, 300000000LL);
-        
-        // Store results
-        for (size_t i = 0; i < gameState.horseNames.size(); ++i) {
-            gameState.previousResults[i] = gameState.contributions[i];
-        }
     }
+    game.BeginFrame(); // Closes the last frame in the profiler
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-    std::string FormatMoney(long long amount) {
-        std::string result;
-        if (amount >= 100000000) {
-            long long oku = amount / 100000000;
-            long long man = (amount % 100000000) / 10000;
-            if (man == 0) {
-                result = std::to_string(oku) + "億円";
-            } else {
-                result = std::to_string(oku) + "億" + std::to_string(man) + "万円";
-            }
-        } else if (amount >= 10000) {
-            result = std::to_string(amount / 10000) + "万円";
-        } else {
-            result = std::to_string(amount) + "円";
-        }
-        return result;
+    std::cout << "Rendered " << frame << " frames in " << std::fixed << std::setprecision(3) << seconds
+              << " s (" << std::setprecision(1) << frame / seconds << " fps), " << clock.Now() << " s of game time" << std::endl;
+    if (options.races > 0) {
+        std::cout << "Finished " << racesFinished << " races (" << racesFinished / seconds << " races/s)" << std::endl;
     }
+    std::cout << std::defaultfloat;
+    game.PrintFrameStats(std::cout);
 
-    void DrawContributions() {
-        // Draw contributions on screen
-        if (!gameState.isRacing) {
-            int y = 10;
-            int x = 10;
-            SDL_Color color = {255, 255, 255, 255};
-            std::string contributionsText = "現在の貢ぎ額:";
-            for (size_t i = 0; i < gameState.horseNames.size(); i++) {
-                contributionsText += gameState.horseNames[i] + ": " + FormatMoney(gameState.contributions[i]);
-                if (i < gameState.horseNames.size() - 1) {
-                    contributionsText += ", ";
-                }
-            }
-            SDL_Texture* textTexture = RenderText(contributionsText, color);
-            if (textTexture) {
-                SDL_Rect textRect = {x, y, 0, 0};
-                SDL_QueryTexture(textTexture, NULL, NULL, &textRect.w, &textRect.h);
-                SDL_RenderCopy(renderer, textTexture, NULL, &textRect);
-                SDL_DestroyTexture(textTexture);
-            }
-        }
-    }
-    
-    void DrawRaceResult() {
-        // Draw race result on screen
-        int y = 400;
-        int x = 10;
-        SDL_Color color = {255, 255, 255, 255};
-        
-        // Sort horses by contribution
-        std::vector<size_t> indices(gameState.horseNames.size());
-        std::iota(indices.begin(), indices.end(), 0);
-        std::sort(indices.begin(), indices.end(),
-                 [this](size_t a, size_t b) {
-                     return gameState.previousResults[a] > gameState.previousResults[b];
-                 });
-        
-        // Display results
-        std::string resultText = "🏆レース結果🏆";
-        SDL_Texture* textTexture = RenderText(resultText, color);
-        if (textTexture) {
-            SDL_Rect textRect = {x, y, 0, 0};
-            SDL_QueryTexture(textTexture, NULL, NULL, &textRect.w, &textRect.h);
-            SDL_RenderCopy(renderer, textTexture, NULL, &textRect);
-            SDL_DestroyTexture(textTexture);
-        }
-        y += 30;
-        for (size_t i = 0; i < 3; i++) {
-            resultText = std::to_string(i+1) + "位: " + gameState.horseNames[indices[i]] + " - " + FormatMoney(gameState.previousResults[indices[i]]);
-            textTexture = RenderText(resultText, color);
-            if (textTexture) {
-                SDL_Rect textRect = {x, y, 0, 0};
-                SDL_QueryTexture(textTexture, NULL, NULL, &textRect.w, &textRect.h);
-                SDL_RenderCopy(renderer, textTexture, NULL, &textRect);
-                SDL_DestroyTexture(textTexture);
-            }
-            y += 30;
-        }
-        
-        long long totalPrize = 0;
-        for (size_t i = 0; i < 3; i++) {
-            totalPrize += gameState.previousResults[indices[i]];
-        }
-        totalPrize = std::min(totalPrize, 300000000LL);
-        
-        resultText = "✨獲得賞金: " + FormatMoney(totalPrize) + "✨";
-        textTexture = RenderText(resultText, color);
-        if (textTexture) {
-            SDL_Rect textRect = {x, y, 0, 0};
-            SDL_QueryTexture(textTexture, NULL, NULL, &textRect.w, &textRect.h);
-            SDL_RenderCopy(renderer, textTexture, NULL, &textRect);
-            SDL_DestroyTexture(textTexture);
-        }
+    if (options.checkAllocationsAfter >= 0) {
+        std::cout << "Heap allocations after frame " << options.checkAllocationsAfter << ": " << allocations
+                  << " in " << allocatingFrames << " frames" << std::endl;
     }
+    return allocatingFrames == 0;
+}
 
-    void DrawHorses() {
-        for (size_t i = 0; i < resources.horseImages.size(); i++) {
-            int x = 550 + (i % 3) * 220;
-            int y = 90 + (i / 3) * 210;
-            SDL_Rect horseRect = {x, y, 200, 200};
-
-            if (resources.horseImages[i]) {
-                SDL_RenderCopy(renderer, resources.horseImages[i], NULL, &horseRect);
-            } else {
-                // Draw placeholder if texture is missing
-                SDL_SetRenderDrawColor(renderer, 200, 100, 100, 255);
-                SDL_RenderFillRect(renderer, &horseRect);
-            }
-            
-            // Draw horse name below the image
-            if (resources.horseNameTextures[i]) {
-                SDL_Rect nameRect;
-                SDL_QueryTexture(resources.horseNameTextures[i], NULL, NULL, &nameRect.w, &nameRect.h);
-                nameRect.x = x + (200 - nameRect.w) / 2;
-                nameRect.y = y + 200;
-                SDL_RenderCopy(renderer, resources.horseNameTextures[i], NULL, &nameRect);
+int main(int argc, char* argv[]) {
+    int tickRate = DEFAULT_TICK_RATE;
+    double raceSeconds = 0;
+    int numHorses = DEFAULT_HORSES;
+    std::string profileCsv;
+    std::string journalPath;
+    JournalSync journalSync = JOURNAL_SYNC_BATCH;
+    int journalIntervalMs = DEFAULT_JOURNAL_INTERVAL_MS;
+    std::string recordDir;
+    bool fixedSeed = false;
+    uint64_t seed = 0;
+    double timeScale = 1.0;
+    double virtualStep = 0;         // > 0: virtual clock with this many game seconds per frame
+    bool watchAssets = false;
+    std::string historyPath;
+    HeadlessOptions headless;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--tick-rate") && i + 1 < argc) {
+            tickRate = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--race-seconds") && i + 1 < argc) {
+            raceSeconds = std::max(0.0, atof(argv[++i]));
+        } else if (!strcmp(argv[i], "--horses") && i + 1 < argc) {
+            numHorses = std::max(1, std::min(atoi(argv[++i]), MAX_HORSES));
+        } else if (!strcmp(argv[i], "--profile-csv") && i + 1 < argc) {
+            profileCsv = argv[++i];
+        } else if (!strcmp(argv[i], "--journal") && i + 1 < argc) {
+            journalPath = argv[++i];
+        } else if (!strcmp(argv[i], "--journal-sync") && i + 1 < argc) {
+            journalSync = !strcmp(argv[++i], "none") ? JOURNAL_SYNC_NONE : JOURNAL_SYNC_BATCH;
+        } else if (!strcmp(argv[i], "--journal-interval-ms") && i + 1 < argc) {
+            journalIntervalMs = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--record") && i + 1 < argc) {
+            recordDir = argv[++i];
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            fixedSeed = true;
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--time-scale") && i + 1 < argc) {
+            timeScale = std::max(0.001, atof(argv[++i]));
+        } else if (!strcmp(argv[i], "--virtual-clock") && i + 1 < argc) {
+            virtualStep = std::max(0.0, atof(argv[++i]));
+        } else if (!strcmp(argv[i], "--watch-assets")) {
+            watchAssets = true;
+        } else if (!strcmp(argv[i], "--history") && i + 1 < argc) {
+            historyPath = argv[++i];
+        } else if (!strcmp(argv[i], "--headless")) {
+            headless.enabled = true;
+        } else if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+            headless.frames = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--races") && i + 1 < argc) {
+            headless.races = std::max(0, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--start-race")) {
+            headless.startRace = true;
+        } else if (!strcmp(argv[i], "--contributions-per-frame") && i + 1 < argc) {
+            headless.contributionsPerFrame = std::max(0, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--capture") && i + 1 < argc) {
+            // Comma-separated frame numbers
+            std::stringstream list(argv[++i]);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                if (!item.empty()) headless.captureFrames.insert(atoi(item.c_str()));
             }
-        }
-    }
-
-    void DrawDebugInfo() {
-        // Draw debug info on screen
-        int y = WINDOW_HEIGHT - 30;
-        int x = 10;
-        SDL_Color color = {255, 255, 255, 255};
-        std::string debugText;
-        if (!gameState.isRacing) {
-            debugText = "ゲーム状態: 待機中 | スペースキーでレース開始 | Cキーで馬に貢ぐ | ESCで終了";
+        } else if (!strcmp(argv[i], "--capture-dir") && i + 1 < argc) {
+            headless.captureDir = argv[++i];
+        } else if (!strcmp(argv[i], "--check-allocations") && i + 1 < argc) {
+            headless.checkAllocationsAfter = std::max(0, atoi(argv[++i]));
         } else {
-            debugText = "ゲーム状態: レース中...";
-        }
-        SDL_Texture* textTexture = RenderText(debugText, color);
-        if (textTexture) {
-            SDL_Rect textRect = {x, y, 0, 0};
-            SDL_QueryTexture(textTexture, NULL, NULL, &textRect.w, &textRect.h);
-            SDL_RenderCopy(renderer, textTexture, NULL, &textRect);
-            SDL_DestroyTexture(textTexture);
+            std::cerr << "Usage: " << argv[0] << " [--tick-rate N] [--race-seconds N] [--horses N] [--profile-csv FILE]"
+                      << " [--journal FILE [--journal-sync none|batch] [--journal-interval-ms N]] [--record DIR] [--seed N]"
+                      << " [--time-scale X | --virtual-clock SECONDS_PER_FRAME] [--watch-assets] [--history FILE]" << std::endl;
+            std::cerr << "       " << argv[0] << " --headless [--frames N | --races N] [--start-race] [--contributions-per-frame N] [--capture N,N,...] [--capture-dir DIR]"
+                      << " [--check-allocations WARMUP_FRAMES]" << std::endl;
+            return 1;
         }
     }
-};
 
-int main(int argc, char* argv[]) {
     // Print SDL versions for debugging
     SDL_version compiled;
     SDL_VERSION(&compiled);
@@ -569,15 +191,21 @@ int main(int argc, char* argv[]) {
     SDL_GetVersion(&linked);
     std::cout << "SDL Linked version: " << (int)linked.major << "." << (int)linked.minor << "." << (int)linked.patch << std::endl;
 
-    // Initialize SDL with error checking
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
+    // Initialize SDL with error checking; headless runs need neither a display nor sound
+    if (headless.enabled) {
+        SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+    }
+    Uint32 sdlFlags = headless.enabled ? SDL_INIT_TIMER : SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER;
+    if (SDL_Init(sdlFlags) < 0) {
         std::cerr << "SDL could not initialize! SDL_Error: " << SDL_GetError() << std::endl;
         return 1;
     }
     std::cout << "SDL initialized successfully." << std::endl;
 
     // Initialize SDL_mixer with error checking
-    if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) < 0) {
+    if (headless.enabled) {
+        std::cout << "Headless mode: running without sound." << std::endl;
+    } else if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) < 0) {
         std::cerr << "SDL_mixer could not initialize! SDL_mixer Error: " << Mix_GetError() << std::endl;
         std::cout << "Game will continue without sound." << std::endl;
     } else {
@@ -601,8 +229,47 @@ int main(int argc, char* argv[]) {
     }
     std::cout << "SDL_ttf initialized successfully." << std::endl;
 
+    // Headless: offscreen software rendering, no window
+    SDL_Window* window = NULL;
+    SDL_Renderer* renderer = NULL;
+    SDL_Surface* offscreenTarget = NULL;
+    if (headless.enabled) {
+        renderer = CreateOffscreenRenderer(&offscreenTarget);
+        if (renderer == NULL) {
+            std::cerr << "Offscreen renderer could not be created! SDL_Error: " << SDL_GetError() << std::endl;
+            return 1;
+        }
+        std::cout << "Offscreen software renderer created successfully." << std::endl;
+
+        bool headlessOk = true;
+        {
+            HorseRacingGame game(window, renderer, numHorses);
+            game.SetRaceSeconds(raceSeconds);
+            if (!profileCsv.empty() && game.OpenProfileCsv(profileCsv)) {
+                std::cout << "Writing frame timings to " << profileCsv << std::endl;
+            }
+            if (!journalPath.empty() && !game.OpenJournal(journalPath, journalSync, journalIntervalMs)) {
+                return 1;
+            }
+            if (!recordDir.empty()) game.SetRecordDirectory(recordDir);
+            if (fixedSeed) game.SetRaceSeed(seed);
+            if (!historyPath.empty() && !game.OpenHistory(historyPath)) {
+                return 1;
+            }
+            GameClock clock = virtualStep > 0 ? GameClock::Virtual(virtualStep)
+                            : timeScale != 1.0 ? GameClock::Scaled(timeScale)
+                            : GameClock::Virtual(HEADLESS_FRAME_SECONDS);
+            headlessOk = RunHeadless(game, offscreenTarget, headless, tickRate, clock);
+        } // The game destroys the renderer
+        SDL_FreeSurface(offscreenTarget);
+        TTF_Quit();
+        IMG_Quit();
+        SDL_Quit();
+        return headlessOk ? 0 : 1;
+    }
+
     // Create window with error checking
-    SDL_Window* window = SDL_CreateWindow("Equis - Handsome Guys Derby",
+    window = SDL_CreateWindow("Equis - Handsome Guys Derby",
                                           SDL_WINDOWPOS_UNDEFINED,
                                           SDL_WINDOWPOS_UNDEFINED,
                                           WINDOW_WIDTH,
@@ -614,54 +281,140 @@ int main(int argc, char* argv[]) {
     }
     std::cout << "Window created successfully." << std::endl;
 
-    // Create renderer with error checking
-    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    // Create renderer with error checking. Presents wait for vsync, which paces
+    // racing frames; a virtual clock runs unthrottled instead.
+    Uint32 rendererFlags = SDL_RENDERER_ACCELERATED | (virtualStep > 0 ? 0 : SDL_RENDERER_PRESENTVSYNC);
+    renderer = SDL_CreateRenderer(window, -1, rendererFlags);
     if (renderer == NULL) {
         std::cerr << "Renderer could not be created! SDL_Error: " << SDL_GetError() << std::endl;
         return 1;
     }
-    std::cout << "Renderer created successfully." << std::endl;
+    SDL_RendererInfo rendererInfo;
+    bool vsync = SDL_GetRendererInfo(renderer, &rendererInfo) == 0 && (rendererInfo.flags & SDL_RENDERER_PRESENTVSYNC);
+    std::cout << "Renderer created successfully" << (vsync ? " (vsync)." : ".") << std::endl;
 
     // Print current working directory
     std::cout << "Current working directory: " << std::filesystem::current_path() << std::endl;
 
     // Create and run game
     std::cout << "Creating game instance..." << std::endl;
-    HorseRacingGame game(window, renderer);
+    HorseRacingGame game(window, renderer, numHorses);
+    game.SetRaceSeconds(raceSeconds);
+    if (!profileCsv.empty() && game.OpenProfileCsv(profileCsv)) {
+        std::cout << "Writing frame timings to " << profileCsv << std::endl;
+    }
+    if (!journalPath.empty() && !game.OpenJournal(journalPath, journalSync, journalIntervalMs)) {
+        return 1;
+    }
+    if (!recordDir.empty()) game.SetRecordDirectory(recordDir);
+    if (fixedSeed) game.SetRaceSeed(seed);
+    if (watchAssets) game.WatchAssets();
+    if (!historyPath.empty() && !game.OpenHistory(historyPath)) {
+        return 1;
+    }
 
     std::cout << "\nGame Controls:" << std::endl;
     std::cout << "  Space - Start race" << std::endl;
-    std::cout << "  C     - Contribute to a horse" << std::endl;
+    std::cout << "  C     - Contribute to a horse (or click it)" << std::endl;
+    std::cout << "  Arrows / mouse wheel - Scroll the horse grid" << std::endl;
+    std::cout << "  + / - / Ctrl+wheel   - Zoom the horse grid (Home resets)" << std::endl;
+    std::cout << "  F3    - Toggle frame profiler" << std::endl;
+    std::cout << "  H     - Print race history (with --history)" << std::endl;
     std::cout << "  ESC   - Quit game" << std::endl;
     std::cout << "\nPress any key to continue..." << std::endl;
 
     // 初期画面を表示
     game.DrawUI();
 
-    std::cout << "Starting game loop..." << std::endl;
+    std::cout << "Starting game loop (" << tickRate << " ticks/s)..." << std::endl;
+    const double tickSeconds = 1.0 / tickRate;
+    GameClock clock = virtualStep > 0 ? GameClock::Virtual(virtualStep) : GameClock::Scaled(timeScale);
+    double accumulator = 0;
+
     bool quit = false;
     SDL_Event e;
+    std::vector<Uint32> inputTimestamps; // Inputs handled this frame, for their latency once presented
     while (!quit) {
-        bool needRedraw = false;
+        // Nothing moving: sleep until input arrives instead of waking every frame.
+        // The sleep is not simulated; game time only matters while racing.
+        bool animating = game.IsAnimating();
+        if (!animating) {
+            SDL_WaitEventTimeout(NULL, IDLE_WAIT_MS);
+            clock.Skip();
+        }
+        Uint64 frameStart = SDL_GetPerformanceCounter();
+
+        game.BeginFrame();
         while (SDL_PollEvent(&e) != 0) {
-            needRedraw = true;
+            if (e.type == SDL_KEYDOWN || e.type == SDL_MOUSEBUTTONDOWN || e.type == SDL_MOUSEWHEEL) {
+                inputTimestamps.push_back(e.common.timestamp);
+            }
             if (e.type == SDL_QUIT) {
                 quit = true;
+            } else if (e.type == SDL_RENDER_TARGETS_RESET) {
+                game.InvalidateLayers(); // Their contents are gone
+            } else if (e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT) {
+                game.HandleClick(e.button.x, e.button.y);
+            } else if (e.type == SDL_MOUSEWHEEL) {
+                if (SDL_GetModState() & KMOD_CTRL) {
+                    int mouseX, mouseY;
+                    SDL_GetMouseState(&mouseX, &mouseY);
+                    game.ZoomHorseView(std::pow(1.1, e.wheel.y), mouseX, mouseY);
+                } else {
+                    game.PanHorseView(-e.wheel.x * 60.0, -e.wheel.y * 60.0);
+                }
             } else if (e.type == SDL_KEYDOWN) {
-                if (e.key.keysym.sym == SDLK_SPACE) {
+                SDL_Keycode key = e.key.keysym.sym;
+                int centerX = HORSE_VIEW.x + HORSE_VIEW.w / 2, centerY = HORSE_VIEW.y + HORSE_VIEW.h / 2;
+                if (game.HandlePromptKey(key)) {
+                    // Typed into the contribution prompt
+                } else if (key == SDLK_SPACE) {
                     game.StartRace();
-                } else if (e.key.keysym.sym == SDLK_c) {
-                    game.ShowContributionDialog();
-                } else if (e.key.keysym.sym == SDLK_ESCAPE) {
+                } else if (key == SDLK_c) {
+                    game.OpenContributionPrompt();
+                } else if (key == SDLK_F3) {
+                    game.ToggleProfilerOverlay();
+                } else if (key == SDLK_h) {
+                    game.PrintHistory(std::cout);
+                } else if (key == SDLK_LEFT || key == SDLK_RIGHT) {
+                    game.PanHorseView(key == SDLK_LEFT ? -100 : 100, 0);
+                } else if (key == SDLK_UP || key == SDLK_DOWN) {
+                    game.PanHorseView(0, key == SDLK_UP ? -100 : 100);
+                } else if (key == SDLK_PLUS || key == SDLK_EQUALS || key == SDLK_KP_PLUS) {
+                    game.ZoomHorseView(1.25, centerX, centerY);
+                } else if (key == SDLK_MINUS || key == SDLK_KP_MINUS) {
+                    game.ZoomHorseView(0.8, centerX, centerY);
+                } else if (key == SDLK_HOME) {
+                    game.ResetHorseView();
+                } else if (key == SDLK_ESCAPE) {
                     quit = true;
                 }
             }
         }
-        if(needRedraw){
-            game.DrawUI();
+
+        // Run as many fixed ticks as game time has covered, then draw in between them.
+        // After a sleep, one tick applies whatever the input queued.
+        accumulator += clock.Advance(MAX_FRAME_SECONDS);
+        if (!animating) accumulator = std::max(accumulator, tickSeconds);
+        while (accumulator >= tickSeconds) {
+            game.Update(tickSeconds);
+            accumulator -= tickSeconds;
+        }
+        game.DrawUI(accumulator / tickSeconds);
+
+        Uint32 presented = SDL_GetTicks();
+        for (Uint32 timestamp : inputTimestamps) {
+            game.RecordInputLatency(presented - timestamp);
+        }
+        inputTimestamps.clear();
+
+        // Vsync paces racing frames; without it, sleep out the rest of the frame
+        if (animating && !vsync && !clock.IsVirtual()) {
+            double frameMs = (SDL_GetPerformanceCounter() - frameStart) * 1000.0 / SDL_GetPerformanceFrequency();
+            if (frameMs < FALLBACK_FRAME_MS) SDL_Delay((Uint32)(FALLBACK_FRAME_MS - frameMs));
         }
-        SDL_Delay(16); // Approx 60 FPS
     }
+    game.PrintFrameStats(std::cout);
 
     std::cout << "Game loop ended." << std::endl;
 
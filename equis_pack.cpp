@@ -0,0 +1,200 @@
+// Offline asset packer.
+// Decodes every image in REQUIRED_ASSETS, scales it down to the size it is
+// drawn at, and writes raw RGBA together with the font and BGM bytes into a
+// single versioned pack that the game maps at startup.
+//
+//   ./equis_pack [output.pack]
+
+#include <SDL.h>
+#include <SDL_image.h>
+#include "asset_pack.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+struct PackedAsset {
+    PackEntry entry;
+    std::vector<uint8_t> bytes;
+};
+
+// Area-averaging resample along one axis. Each destination pixel is the
+// weighted mean of the source pixels it covers, so large reductions
+// (1024 -> 400) do not alias the way bilinear sampling would. Colors must be
+// premultiplied by alpha, or transparent pixels bleed their color into the
+// edges of what is left.
+static void ResampleAxis(const float* src, int srcCount, int srcStride, float* dst, int dstCount, int dstStride,
+                         int lines, int lineStrideSrc, int lineStrideDst) {
+    double scale = (double)srcCount / dstCount;
+    for (int line = 0; line < lines; line++) {
+        const float* s = src + (size_t)line * lineStrideSrc;
+        float* d = dst + (size_t)line * lineStrideDst;
+        for (int i = 0; i < dstCount; i++) {
+            double start = i * scale;
+            double end = start + scale;
+            float sum[4] = {0, 0, 0, 0};
+            for (int j = (int)start; j < end && j < srcCount; j++) {
+                double weight = std::min<double>(j + 1, end) - std::max<double>(j, start);
+                const float* pixel = s + (size_t)j * srcStride;
+                for (int c = 0; c < 4; c++) sum[c] += (float)(pixel[c] * weight);
+            }
+            float* out = d + (size_t)i * dstStride;
+            for (int c = 0; c < 4; c++) out[c] = (float)(sum[c] / scale);
+        }
+    }
+}
+
+// Returns tightly packed RGBA32 pixels of the requested size
+static std::vector<uint8_t> Downscale(SDL_Surface* rgba, int width, int height) {
+    int sw = rgba->w, sh = rgba->h;
+    std::vector<float> source((size_t)sw * sh * 4);
+    for (int y = 0; y < sh; y++) {
+        const uint8_t* row = static_cast<const uint8_t*>(rgba->pixels) + (size_t)y * rgba->pitch;
+        float* out = &source[(size_t)y * sw * 4];
+        for (int x = 0; x < sw * 4; x += 4) {
+            float alpha = row[x + 3] / 255.0f;
+            for (int c = 0; c < 3; c++) out[x + c] = row[x + c] * alpha;
+            out[x + 3] = row[x + 3];
+        }
+    }
+
+    // Horizontal pass (sw x sh -> width x sh), then vertical (-> width x height)
+    std::vector<float> horizontal((size_t)width * sh * 4);
+    ResampleAxis(source.data(), sw, 4, horizontal.data(), width, 4, sh, sw * 4, width * 4);
+    std::vector<float> scaled((size_t)width * height * 4);
+    ResampleAxis(horizontal.data(), sh, width * 4, scaled.data(), height, width * 4, width, 4, 4);
+
+    // Back to straight alpha, which is what the textures are blended as
+    std::vector<uint8_t> pixels(scaled.size());
+    auto toByte = [](float v) { v += 0.5f; return (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v); };
+    for (size_t i = 0; i < scaled.size(); i += 4) {
+        float alpha = scaled[i + 3];
+        float unpremultiply = alpha > 0 ? 255.0f / alpha : 0.0f;
+        for (int c = 0; c < 3; c++) pixels[i + c] = toByte(scaled[i + c] * unpremultiply);
+        pixels[i + 3] = toByte(alpha);
+    }
+    return pixels;
+}
+
+static bool PackImage(const AssetSpec& spec, PackedAsset& asset) {
+    SDL_Surface* loaded = IMG_Load(spec.name);
+    if (!loaded) {
+        std::cerr << "Failed to load image: " << spec.name << ", Error: " << IMG_GetError() << std::endl;
+        return false;
+    }
+    SDL_Surface* rgba = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_FreeSurface(loaded);
+    if (!rgba) {
+        std::cerr << "Failed to convert " << spec.name << " to RGBA, Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    // Only ever shrink; images smaller than their drawn size are cheaper to upscale on draw
+    int width = std::min(rgba->w, spec.drawWidth);
+    int height = std::min(rgba->h, spec.drawHeight);
+    if (width == rgba->w && height == rgba->h) {
+        asset.bytes.resize((size_t)width * height * 4);
+        for (int y = 0; y < height; y++) {
+            memcpy(&asset.bytes[(size_t)y * width * 4], static_cast<const uint8_t*>(rgba->pixels) + (size_t)y * rgba->pitch, (size_t)width * 4);
+        }
+    } else {
+        asset.bytes = Downscale(rgba, width, height);
+    }
+    std::cout << "  " << spec.name << ": " << rgba->w << "x" << rgba->h << " -> " << width << "x" << height << std::endl;
+    SDL_FreeSurface(rgba);
+
+    asset.entry.type = PACK_ENTRY_RGBA;
+    asset.entry.width = width;
+    asset.entry.height = height;
+    return true;
+}
+
+static bool PackBlob(const AssetSpec& spec, PackedAsset& asset) {
+    std::ifstream file(spec.name, std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to open " << spec.name << std::endl;
+        return false;
+    }
+    asset.bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    std::cout << "  " << spec.name << ": " << asset.bytes.size() << " bytes" << std::endl;
+    asset.entry.type = PACK_ENTRY_BLOB;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::string output = argc > 1 ? argv[1] : ASSET_PACK_FILE;
+
+    if (!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG)) {
+        std::cerr << "SDL_image could not initialize! SDL_image Error: " << IMG_GetError() << std::endl;
+        return 1;
+    }
+
+    std::cout << "Packing assets:" << std::endl;
+    std::vector<PackedAsset> assets;
+    bool success = true;
+    for (size_t i = 0; i < REQUIRED_ASSET_COUNT; i++) {
+        const AssetSpec& spec = REQUIRED_ASSETS[i];
+        PackedAsset asset;
+        memset(&asset.entry, 0, sizeof(asset.entry));
+        strncpy(asset.entry.name, spec.name, sizeof(asset.entry.name) - 1);
+
+        bool packed = spec.drawWidth > 0 ? PackImage(spec, asset) : PackBlob(spec, asset);
+        if (!packed) {
+            success = false;
+            continue;
+        }
+        assets.push_back(std::move(asset));
+    }
+    IMG_Quit();
+    if (!success) {
+        std::cerr << "Some assets are missing; not writing " << output << std::endl;
+        return 1;
+    }
+
+    // Header and entry table first, then each payload on an aligned offset
+    PackHeader header;
+    memcpy(header.magic, "EQPK", 4);
+    header.version = ASSET_PACK_VERSION;
+    header.entryCount = (uint32_t)assets.size();
+    header.reserved = 0;
+
+    uint64_t offset = sizeof(PackHeader) + assets.size() * sizeof(PackEntry);
+    for (auto& asset : assets) {
+        offset = (offset + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT;
+        asset.entry.offset = offset;
+        asset.entry.size = asset.bytes.size();
+        offset += asset.bytes.size();
+    }
+
+    // Write to a temporary file and rename, so a running game never maps a half-written pack
+    std::string temporary = output + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Failed to create " << temporary << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (const auto& asset : assets) {
+        written = written && fwrite(&asset.entry, sizeof(asset.entry), 1, file) == 1;
+    }
+    for (const auto& asset : assets) {
+        static const char padding[ASSET_PACK_ALIGNMENT] = {};
+        long position = ftell(file);
+        size_t pad = (size_t)(asset.entry.offset - position);
+        written = written && fwrite(padding, 1, pad, file) == pad;
+        written = written && fwrite(asset.bytes.data(), 1, asset.bytes.size(), file) == asset.bytes.size();
+    }
+    written = (fclose(file) == 0) && written;
+    if (!written || rename(temporary.c_str(), output.c_str()) != 0) {
+        std::cerr << "Failed to write " << output << ": " << strerror(errno) << std::endl;
+        remove(temporary.c_str());
+        return 1;
+    }
+
+    std::cout << "Wrote " << output << " (" << offset << " bytes, version " << ASSET_PACK_VERSION << ")" << std::endl;
+    return 0;
+}
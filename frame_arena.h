@@ -0,0 +1,111 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Bump allocator for data that only lives for one frame.
+// Allocate() carves memory out of the current block and Reset() hands all of
+// it back at once. Blocks are kept across frames; if a frame needed more than
+// one, Reset() replaces them with a single block big enough for all, so after
+// the first frames the arena stops touching the heap.
+class FrameArena {
+public:
+    explicit FrameArena(size_t blockSize = 64 * 1024) : blockSize(blockSize), used(0) {
+        AddBlock(blockSize);
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        size_t offset = (used + alignment - 1) & ~(alignment - 1);
+        if (offset + size > blocks.back().size) {
+            AddBlock(std::max(blockSize, size + alignment));
+            offset = 0;
+        }
+        used = offset + size;
+        return blocks.back().data.get() + offset;
+    }
+
+    // Everything allocated since the last Reset() becomes invalid
+    void Reset() {
+        if (blocks.size() > 1) {
+            size_t total = 0;
+            for (const Block& block : blocks) total += block.size;
+            blocks.clear();
+            AddBlock(total);
+        }
+        used = 0;
+    }
+
+    size_t Capacity() const {
+        size_t total = 0;
+        for (const Block& block : blocks) total += block.size;
+        return total;
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    void AddBlock(size_t size) {
+        Block block;
+        block.data.reset(new char[size]);
+        block.size = size;
+        blocks.push_back(std::move(block));
+        used = 0;
+    }
+
+    size_t blockSize;
+    size_t used;                  // Bytes taken from the last block
+    std::vector<Block> blocks;
+};
+
+// Text assembled in a FrameArena with a fixed capacity; valid until the arena
+// is reset. A piece that does not fit is dropped whole, so UTF-8 characters
+// are never cut in half.
+class FrameText {
+public:
+    FrameText(FrameArena& arena, size_t capacity) :
+        data(static_cast<char*>(arena.Allocate(capacity, 1))), length(0), capacity(capacity) {}
+
+    FrameText& Append(const char* text, size_t size) {
+        if (length + size <= capacity) {
+            memcpy(data + length, text, size);
+            length += size;
+        }
+        return *this;
+    }
+    FrameText& Append(const char* text) { return Append(text, strlen(text)); }
+    FrameText& Append(const std::string& text) { return Append(text.data(), text.size()); }
+    FrameText& AppendNumber(long long value) {
+        char digits[24];
+        return Append(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr - digits);
+    }
+    FrameText& AppendDecimal(double value, int decimals) {
+        char digits[32];
+        std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::fixed, decimals);
+        return result.ec == std::errc() ? Append(digits, result.ptr - digits) : *this;
+    }
+
+    // Room for up to size more bytes, for formatting in place; follow with Commit()
+    char* Reserve(size_t size) { return length + size <= capacity ? data + length : nullptr; }
+    void Commit(size_t size) { length += size; }
+    size_t Remaining() const { return capacity - length; }
+
+    const char* Data() const { return data; }
+    size_t Length() const { return length; }
+    bool Equals(const std::string& text) const { return text.size() == length && memcmp(text.data(), data, length) == 0; }
+
+private:
+    char* data;
+    size_t length;
+    size_t capacity;
+};
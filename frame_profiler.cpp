@@ -0,0 +1,126 @@
+#include "frame_profiler.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+FrameProfiler::FrameProfiler() :
+    inputCount(0),
+    scratch(HISTORY > INPUT_HISTORY ? HISTORY : INPUT_HISTORY),
+    frameCount(0),
+    inFrame(false),
+    csv(nullptr),
+    csvColumns(-1) {
+    memset(current, 0, sizeof(current));
+    memset(history, 0, sizeof(history));
+    memset(frameHistory, 0, sizeof(frameHistory));
+    memset(inputHistory, 0, sizeof(inputHistory));
+    names.reserve(MAX_SECTIONS);
+}
+
+FrameProfiler::~FrameProfiler() {
+    if (csv) fclose(csv);
+}
+
+int FrameProfiler::Section(const char* name) {
+    for (size_t i = 0; i < names.size(); i++) {
+        if (strcmp(names[i], name) == 0) return (int)i;
+    }
+    if ((int)names.size() >= MAX_SECTIONS) {
+        std::cerr << "Too many profiler sections; not timing " << name << std::endl;
+        return -1;
+    }
+    names.push_back(name);
+    return (int)names.size() - 1;
+}
+
+bool FrameProfiler::OpenCsv(const std::string& path) {
+    if (csv) fclose(csv);
+    csv = fopen(path.c_str(), "w");
+    if (!csv) {
+        std::cerr << "Failed to open profile CSV " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    csvColumns = -1;
+    return true;
+}
+
+void FrameProfiler::BeginFrame() {
+    Clock::time_point now = Clock::now();
+    if (inFrame) {
+        // Close the previous frame: its length is the time between frame starts
+        int slot = frameCount % HISTORY;
+        frameHistory[slot] = std::chrono::duration<double, std::milli>(now - frameStart).count();
+        for (int i = 0; i < MAX_SECTIONS; i++) {
+            history[i][slot] = current[i];
+        }
+        if (csv) {
+            WriteCsvRow();
+            if (frameCount % HISTORY == 0) fflush(csv); // Mostly complete even if the process is killed
+        }
+        frameCount++;
+    }
+    memset(current, 0, sizeof(current));
+    frameStart = now;
+    inFrame = true;
+}
+
+void FrameProfiler::AddSample(int section, double ms) {
+    if (section >= 0) current[section] += ms;
+}
+
+void FrameProfiler::WriteCsvRow() {
+    if (csvColumns < 0) {
+        csvColumns = (int)names.size();
+        fputs("frame,frame_ms", csv);
+        for (int i = 0; i < csvColumns; i++) {
+            fprintf(csv, ",%s_ms", names[i]);
+        }
+        fputc('\n', csv);
+    }
+    int slot = frameCount % HISTORY;
+    fprintf(csv, "%d,%.4f", frameCount, frameHistory[slot]);
+    for (int i = 0; i < csvColumns; i++) {
+        fprintf(csv, ",%.4f", history[i][slot]);
+    }
+    fputc('\n', csv);
+}
+
+double FrameProfiler::FrameMs(int age) const {
+    return frameHistory[((frameCount - 1 - age) % HISTORY + HISTORY) % HISTORY];
+}
+
+double FrameProfiler::FramePercentile(double percentile) {
+    int count = FrameCount();
+    if (count == 0) return 0;
+    for (int i = 0; i < count; i++) {
+        scratch[i] = FrameMs(i);
+    }
+    size_t rank = (size_t)(percentile / 100.0 * (count - 1) + 0.5);
+    std::nth_element(scratch.begin(), scratch.begin() + rank, scratch.begin() + count);
+    return scratch[rank];
+}
+
+void FrameProfiler::AddInputLatency(double ms) {
+    inputHistory[inputCount % INPUT_HISTORY] = ms;
+    inputCount++;
+}
+
+double FrameProfiler::InputLatencyPercentile(double percentile) {
+    int count = InputLatencyCount();
+    if (count == 0) return 0;
+    std::copy(inputHistory, inputHistory + count, scratch.begin());
+    size_t rank = (size_t)(percentile / 100.0 * (count - 1) + 0.5);
+    std::nth_element(scratch.begin(), scratch.begin() + rank, scratch.begin() + count);
+    return scratch[rank];
+}
+
+double FrameProfiler::SectionAverageMs(int section) const {
+    int count = FrameCount();
+    if (count == 0) return 0;
+    double sum = 0;
+    for (int i = 0; i < count; i++) {
+        sum += history[section][((frameCount - 1 - i) % HISTORY + HISTORY) % HISTORY];
+    }
+    return sum / count;
+}
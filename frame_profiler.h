@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Per-frame scoped timing.
+// Sections are registered once and timed with PROFILE_SCOPE; each frame's
+// totals go into a ring of recent frames for the overlay and, optionally,
+// one CSV row per frame. Section times are inclusive, so nested sections
+// (DrawText inside DrawContributions) are also counted in their parent.
+class FrameProfiler {
+public:
+    static const int MAX_SECTIONS = 32;
+    static const int HISTORY = 240;
+    static const int INPUT_HISTORY = 256;
+
+    FrameProfiler();
+    ~FrameProfiler();
+
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+    // Returns the id for name, registering it on first use.
+    // Sections registered after the CSV header was written are not exported.
+    int Section(const char* name);
+
+    // Starts a frame and closes the previous one, whose length is the time between the two calls
+    void BeginFrame();
+    void AddSample(int section, double ms);
+
+    // Stream one row per frame to path. Returns false if the file cannot be opened.
+    bool OpenCsv(const std::string& path);
+
+    // Statistics over the last HISTORY frames
+    int FrameCount() const { return frameCount < HISTORY ? frameCount : HISTORY; }
+    double FrameMs(int age) const;                 // 0 = most recent frame
+    double FramePercentile(double percentile);     // percentile in 0..100
+    int SectionCount() const { return (int)names.size(); }
+    const char* SectionName(int section) const { return names[section]; }
+    double SectionAverageMs(int section) const;
+
+    // Time from an input event to the present that first showed its effect
+    void AddInputLatency(double ms);
+    int InputLatencyCount() const { return inputCount < INPUT_HISTORY ? inputCount : INPUT_HISTORY; }
+    double InputLatencyPercentile(double percentile);   // Over the last INPUT_HISTORY inputs
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    void WriteCsvRow();
+
+    std::vector<const char*> names;
+    double current[MAX_SECTIONS];              // Totals for the frame in progress
+    double history[MAX_SECTIONS][HISTORY];     // Section totals per frame
+    double frameHistory[HISTORY];              // Time from one BeginFrame() to the next
+    double inputHistory[INPUT_HISTORY];        // Input latencies, ring
+    int inputCount;
+    std::vector<double> scratch;               // For percentiles, sized once
+    int frameCount;
+    bool inFrame;
+    Clock::time_point frameStart;
+
+    FILE* csv;
+    int csvColumns;                            // Sections in the CSV header
+};
+
+class ProfileScope {
+public:
+    ProfileScope(FrameProfiler& profiler, int section) :
+        profiler(profiler), section(section), start(std::chrono::steady_clock::now()) {}
+    ~ProfileScope() {
+        profiler.AddSample(section, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+private:
+    FrameProfiler& profiler;
+    int section;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+// Time the rest of the enclosing block under name. The section id is looked
+// up once per call site, so this assumes a single profiler per process.
+#define PROFILE_SCOPE(profiler, name) \
+    static const int PROFILE_CONCAT(profileSection_, __LINE__) = (profiler).Section(name); \
+    ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)((profiler), PROFILE_CONCAT(profileSection_, __LINE__))
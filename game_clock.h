@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+// Source of game time for a main loop. Everything timed in the simulation
+// (contribution cadence, background scroll, race end) is driven by the
+// seconds Advance() hands out, so swapping the clock changes how fast a
+// race runs without touching the game.
+//
+//   Real     game time follows the wall clock
+//   Scaled   wall clock times a factor, e.g. 100 for a race in a second
+//   Virtual  every Advance() is a fixed step; no waiting at all
+// Nothing in here depends on SDL.
+class GameClock {
+public:
+    enum Mode {
+        REAL,
+        SCALED,
+        VIRTUAL,
+    };
+
+    static GameClock Real() { return GameClock(REAL, 1.0, 0); }
+    static GameClock Scaled(double scale) { return GameClock(scale == 1.0 ? REAL : SCALED, scale, 0); }
+    static GameClock Virtual(double stepSeconds) { return GameClock(VIRTUAL, 1.0, stepSeconds); }
+
+    // Game seconds since the previous call (or since the clock was made).
+    // maxWallSeconds clamps long stalls before scaling so the loop never spirals.
+    double Advance(double maxWallSeconds) {
+        double seconds;
+        if (mode == VIRTUAL) {
+            seconds = step;
+        } else {
+            WallClock::time_point now = WallClock::now();
+            seconds = std::min(std::chrono::duration<double>(now - last).count(), maxWallSeconds) * scale;
+            last = now;
+        }
+        elapsed += seconds;
+        return seconds;
+    }
+
+    // Let the wall time since the last Advance() pass without handing it out,
+    // e.g. after the loop slept while nothing was moving
+    void Skip() {
+        last = WallClock::now();
+    }
+
+    // Game seconds handed out so far
+    double Now() const { return elapsed; }
+
+    Mode GetMode() const { return mode; }
+    bool IsVirtual() const { return mode == VIRTUAL; }
+    double Scale() const { return scale; }
+
+private:
+    typedef std::chrono::steady_clock WallClock;
+
+    GameClock(Mode mode, double scale, double step) :
+        mode(mode), scale(scale), step(step), elapsed(0), last(WallClock::now()) {}
+
+    Mode mode;
+    double scale;
+    double step;
+    double elapsed;
+    WallClock::time_point last;
+};
@@ -0,0 +1,235 @@
+#include "glyph_atlas.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+const int ATLAS_WIDTH = 1024;
+const int ATLAS_INITIAL_HEIGHT = 256;
+const int ATLAS_MAX_HEIGHT = 4096;
+const int GLYPH_PADDING = 1; // Keeps neighbouring glyphs from bleeding into each other
+}
+
+Uint32 DecodeUTF8(const char* text, size_t length, size_t& pos) {
+    const unsigned char* s = reinterpret_cast<const unsigned char*>(text);
+    unsigned char c = s[pos];
+    int extra;
+    Uint32 codepoint;
+    if (c < 0x80) {
+        pos++;
+        return c;
+    } else if ((c & 0xE0) == 0xC0) {
+        extra = 1;
+        codepoint = c & 0x1F;
+    } else if ((c & 0xF0) == 0xE0) {
+        extra = 2;
+        codepoint = c & 0x0F;
+    } else if ((c & 0xF8) == 0xF0) {
+        extra = 3;
+        codepoint = c & 0x07;
+    } else {
+        pos++;
+        return 0xFFFD;
+    }
+    if (pos + extra >= length) {
+        pos++;
+        return 0xFFFD;
+    }
+    for (int i = 1; i <= extra; i++) {
+        if ((s[pos + i] & 0xC0) != 0x80) {
+            pos++;
+            return 0xFFFD;
+        }
+        codepoint = (codepoint << 6) | (s[pos + i] & 0x3F);
+    }
+    pos += extra + 1;
+    return codepoint;
+}
+
+GlyphAtlas::GlyphAtlas(SDL_Renderer* renderer, TTF_Font* font) :
+    renderer(renderer),
+    font(font),
+    atlasSurface(nullptr),
+    atlasTexture(nullptr),
+    lineHeight(font ? TTF_FontHeight(font) : 0),
+    shelfX(0),
+    shelfY(0),
+    shelfHeight(0) {
+
+    atlasSurface = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_WIDTH, ATLAS_INITIAL_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (!atlasSurface) {
+        std::cerr << "Failed to create glyph atlas surface, Error: " << SDL_GetError() << std::endl;
+        return;
+    }
+    UploadAtlas();
+}
+
+GlyphAtlas::~GlyphAtlas() {
+    if (atlasTexture) SDL_DestroyTexture(atlasTexture);
+    if (atlasSurface) SDL_FreeSurface(atlasSurface);
+}
+
+bool GlyphAtlas::UploadAtlas() {
+    if (atlasTexture) SDL_DestroyTexture(atlasTexture);
+    atlasTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC,
+                                     atlasSurface->w, atlasSurface->h);
+    if (!atlasTexture) {
+        std::cerr << "Failed to create glyph atlas texture, Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    SDL_SetTextureBlendMode(atlasTexture, SDL_BLENDMODE_BLEND);
+    SDL_UpdateTexture(atlasTexture, NULL, atlasSurface->pixels, atlasSurface->pitch);
+    return true;
+}
+
+bool GlyphAtlas::Grow(int minHeight) {
+    int newHeight = atlasSurface->h;
+    while (newHeight < minHeight) newHeight *= 2;
+    if (newHeight > ATLAS_MAX_HEIGHT) {
+        std::cerr << "Glyph atlas is full (" << ATLAS_WIDTH << "x" << ATLAS_MAX_HEIGHT << ")" << std::endl;
+        return false;
+    }
+
+    SDL_Surface* grown = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_WIDTH, newHeight, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (!grown) {
+        std::cerr << "Failed to grow glyph atlas, Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    SDL_SetSurfaceBlendMode(atlasSurface, SDL_BLENDMODE_NONE);
+    SDL_BlitSurface(atlasSurface, NULL, grown, NULL);
+    SDL_FreeSurface(atlasSurface);
+    atlasSurface = grown;
+    return UploadAtlas();
+}
+
+const GlyphAtlas::Glyph* GlyphAtlas::FindOrAddGlyph(Uint32 codepoint) {
+    auto it = glyphs.find(codepoint);
+    if (it != glyphs.end()) {
+        return &it->second;
+    }
+    if (!font || !atlasSurface) {
+        return nullptr;
+    }
+
+    Glyph glyph = {{0, 0, 0, 0}, 0};
+    int minx, maxx, miny, maxy, advance;
+    if (TTF_GlyphMetrics32(font, codepoint, &minx, &maxx, &miny, &maxy, &advance) == 0) {
+        glyph.advance = advance;
+    }
+
+    SDL_Color white = {255, 255, 255, 255};
+    SDL_Surface* surface = TTF_RenderGlyph32_Blended(font, codepoint, white);
+    if (surface) {
+        if (glyph.advance == 0) glyph.advance = surface->w;
+
+        // Shelf packing: start a new row when the current one is full
+        if (shelfX + surface->w + GLYPH_PADDING > ATLAS_WIDTH) {
+            shelfX = 0;
+            shelfY += shelfHeight + GLYPH_PADDING;
+            shelfHeight = 0;
+        }
+        bool fits = shelfY + surface->h <= atlasSurface->h || Grow(shelfY + surface->h);
+        if (fits && surface->w <= ATLAS_WIDTH) {
+            SDL_Rect dst = {shelfX, shelfY, surface->w, surface->h};
+            SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+            SDL_BlitSurface(surface, NULL, atlasSurface, &dst);
+
+            // Upload only the rows touched by this glyph
+            const Uint8* pixels = static_cast<const Uint8*>(atlasSurface->pixels)
+                                  + dst.y * atlasSurface->pitch + dst.x * 4;
+            SDL_UpdateTexture(atlasTexture, &dst, pixels, atlasSurface->pitch);
+
+            glyph.src = dst;
+            shelfX += surface->w + GLYPH_PADDING;
+            shelfHeight = std::max(shelfHeight, surface->h);
+        }
+        SDL_FreeSurface(surface);
+    } else {
+        std::cerr << "Failed to render glyph U+" << std::hex << codepoint << std::dec
+                  << ": " << TTF_GetError() << std::endl;
+    }
+
+    return &glyphs.emplace(codepoint, glyph).first->second;
+}
+
+SDL_Point GlyphAtlas::MeasureText(const std::string& text) {
+    return MeasureText(text.data(), text.size());
+}
+
+SDL_Point GlyphAtlas::MeasureText(const char* text, size_t length) {
+    SDL_Point size = {0, lineHeight};
+    int lineWidth = 0;
+    size_t pos = 0;
+    while (pos < length) {
+        Uint32 codepoint = DecodeUTF8(text, length, pos);
+        if (codepoint == '\n') {
+            size.x = std::max(size.x, lineWidth);
+            size.y += lineHeight;
+            lineWidth = 0;
+            continue;
+        }
+        const Glyph* glyph = FindOrAddGlyph(codepoint);
+        if (glyph) lineWidth += glyph->advance;
+    }
+    size.x = std::max(size.x, lineWidth);
+    return size;
+}
+
+int GlyphAtlas::DrawText(const std::string& text, int x, int y, SDL_Color color) {
+    return DrawText(text.data(), text.size(), x, y, color);
+}
+
+int GlyphAtlas::DrawText(const char* text, size_t length, int x, int y, SDL_Color color) {
+    vertices.clear();
+    indices.clear();
+
+    int penX = x;
+    int penY = y;
+    int width = 0;
+    size_t pos = 0;
+    while (pos < length) {
+        Uint32 codepoint = DecodeUTF8(text, length, pos);
+        if (codepoint == '\n') {
+            width = std::max(width, penX - x);
+            penX = x;
+            penY += lineHeight;
+            continue;
+        }
+        const Glyph* glyph = FindOrAddGlyph(codepoint);
+        if (!glyph) continue;
+
+        if (glyph->src.w > 0 && glyph->src.h > 0) {
+            // Texture coordinates are kept in pixels until the end: the atlas may
+            // still grow while later glyphs of this string are being added.
+            float x0 = (float)penX, y0 = (float)penY;
+            float x1 = x0 + glyph->src.w, y1 = y0 + glyph->src.h;
+            float u0 = (float)glyph->src.x, v0 = (float)glyph->src.y;
+            float u1 = u0 + glyph->src.w, v1 = v0 + glyph->src.h;
+
+            int base = (int)vertices.size();
+            vertices.push_back({{x0, y0}, color, {u0, v0}});
+            vertices.push_back({{x1, y0}, color, {u1, v0}});
+            vertices.push_back({{x1, y1}, color, {u1, v1}});
+            vertices.push_back({{x0, y1}, color, {u0, v1}});
+            indices.push_back(base);
+            indices.push_back(base + 1);
+            indices.push_back(base + 2);
+            indices.push_back(base);
+            indices.push_back(base + 2);
+            indices.push_back(base + 3);
+        }
+        penX += glyph->advance;
+    }
+    width = std::max(width, penX - x);
+
+    if (!vertices.empty() && atlasTexture) {
+        float invW = 1.0f / atlasSurface->w;
+        float invH = 1.0f / atlasSurface->h;
+        for (auto& vertex : vertices) {
+            vertex.tex_coord.x *= invW;
+            vertex.tex_coord.y *= invH;
+        }
+        SDL_RenderGeometry(renderer, atlasTexture, vertices.data(), (int)vertices.size(),
+                           indices.data(), (int)indices.size());
+    }
+    return width;
+}
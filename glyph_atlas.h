@@ -0,0 +1,57 @@
+#pragma once
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Glyph cache for a single TTF_Font.
+// Each codepoint is rasterized once into a packed atlas texture (shelf packing,
+// the atlas doubles in height when it runs out of room) and strings are drawn
+// as one batch of textured quads. Once every glyph of a label has been seen,
+// drawing it neither allocates nor uploads anything.
+class GlyphAtlas {
+public:
+    GlyphAtlas(SDL_Renderer* renderer, TTF_Font* font);
+    ~GlyphAtlas();
+
+    GlyphAtlas(const GlyphAtlas&) = delete;
+    GlyphAtlas& operator=(const GlyphAtlas&) = delete;
+
+    // Draw UTF-8 text with its top-left corner at (x, y). Returns the drawn width.
+    int DrawText(const std::string& text, int x, int y, SDL_Color color);
+    int DrawText(const char* text, size_t length, int x, int y, SDL_Color color);
+
+    // Width and height the text would occupy, rasterizing missing glyphs if needed.
+    SDL_Point MeasureText(const std::string& text);
+    SDL_Point MeasureText(const char* text, size_t length);
+
+    int LineHeight() const { return lineHeight; }
+
+private:
+    struct Glyph {
+        SDL_Rect src;   // Location in the atlas (w/h may be 0 for blank glyphs)
+        int advance;    // Horizontal pen advance in pixels
+    };
+
+    const Glyph* FindOrAddGlyph(Uint32 codepoint);
+    bool Grow(int minHeight);
+    bool UploadAtlas();
+
+    SDL_Renderer* renderer;
+    TTF_Font* font;
+    SDL_Surface* atlasSurface; // CPU copy, used to rebuild the texture when the atlas grows
+    SDL_Texture* atlasTexture;
+    int lineHeight;
+    int shelfX, shelfY, shelfHeight;
+    std::unordered_map<Uint32, Glyph> glyphs;
+
+    // Reused between calls so that steady-state drawing does not allocate
+    std::vector<SDL_Vertex> vertices;
+    std::vector<int> indices;
+};
+
+// Decode one codepoint from a UTF-8 byte range, advancing pos.
+// Malformed sequences yield U+FFFD and consume one byte.
+Uint32 DecodeUTF8(const char* text, size_t length, size_t& pos);
@@ -0,0 +1,321 @@
+#include "journal.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static std::array<uint32_t, 256> MakeCrcTable() {
+    std::array<uint32_t, 256> table;
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t value = i;
+        for (int bit = 0; bit < 8; bit++) {
+            value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+        }
+        table[i] = value;
+    }
+    return table;
+}
+
+uint32_t Crc32(const void* data, size_t length) {
+    static const std::array<uint32_t, 256> table = MakeCrcTable();
+
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static uint32_t RecordCrc(const JournalRecord& record) {
+    return Crc32(reinterpret_cast<const char*>(&record) + sizeof(record.crc), sizeof(record) - sizeof(record.crc));
+}
+
+static JournalRecord MakeRecord(uint32_t type, int32_t horse, int64_t amount) {
+    JournalRecord record;
+    record.type = type;
+    record.horse = horse;
+    record.reserved = 0;
+    record.amount = amount;
+    record.crc = RecordCrc(record);
+    return record;
+}
+
+static bool WriteAll(int fd, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = write(fd, bytes, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool WriteHeader(int fd, uint32_t numHorses) {
+    JournalHeader header;
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+    header.version = JOURNAL_VERSION;
+    header.numHorses = numHorses;
+    header.reserved = 0;
+    return WriteAll(fd, &header, sizeof(header));
+}
+
+// Make a rename in the directory of path durable
+static bool SyncDirectory(const std::string& path) {
+    size_t slash = path.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int dirFd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) return false;
+    bool ok = fsync(dirFd) == 0;
+    close(dirFd);
+    return ok;
+}
+
+Journal::Journal() :
+    fd(-1),
+    numHorses(0),
+    sync(JOURNAL_SYNC_BATCH),
+    commitIntervalMs(DEFAULT_JOURNAL_INTERVAL_MS),
+    replayed(0),
+    checkpointPending(false),
+    checkpointAt(0),
+    stopping(false) {}
+
+Journal::~Journal() {
+    Close();
+}
+
+bool Journal::Open(const std::string& path, int numHorses, JournalSync sync, int commitIntervalMs,
+                   const std::function<void(const JournalRecord&)>& replay) {
+    Close();
+    this->path = path;
+    temporaryPath = path + ".tmp";
+    this->numHorses = (uint32_t)numHorses;
+    this->sync = sync;
+    this->commitIntervalMs = std::max(1, commitIntervalMs);
+
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to open journal " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    if (!Replay(path, numHorses, replay)) {
+        close(fd);
+        fd = -1;
+        return false;
+    }
+
+    pending.reserve(JOURNAL_COMMIT_BATCH);
+    checkpointPending = false;
+    stopping = false;
+    writer = std::thread(&Journal::WriterLoop, this);
+    return true;
+}
+
+bool Journal::Replay(const std::string& path, int numHorses, const std::function<void(const JournalRecord&)>& replay) {
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        std::cerr << "Failed to stat journal " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    if (info.st_size < (off_t)sizeof(JournalHeader)) {
+        // New (or never finished) journal: start it over
+        if (ftruncate(fd, 0) != 0 || !WriteHeader(fd, (uint32_t)numHorses) || fsync(fd) != 0) {
+            std::cerr << "Failed to create journal " << path << ": " << strerror(errno) << std::endl;
+            return false;
+        }
+        replayed = 0;
+        return true;
+    }
+
+    JournalHeader header;
+    if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) != 0 || header.version != JOURNAL_VERSION) {
+        std::cerr << path << " is not a version " << JOURNAL_VERSION << " journal" << std::endl;
+        return false;
+    }
+    if ((int)header.numHorses != numHorses) {
+        std::cerr << "Journal " << path << " was written for " << header.numHorses << " horses, not "
+                  << numHorses << "; horses outside the field are ignored" << std::endl;
+    }
+
+    // Read in large chunks; stop at the first record that is cut short or fails its checksum
+    std::vector<JournalRecord> chunk(65536);
+    off_t offset = sizeof(JournalHeader);
+    long long records = 0;
+    bool torn = false;
+    while (!torn) {
+        ssize_t bytes = pread(fd, chunk.data(), chunk.size() * sizeof(JournalRecord), offset);
+        if (bytes < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Failed to read journal " << path << ": " << strerror(errno) << std::endl;
+            return false;
+        }
+        size_t count = (size_t)bytes / sizeof(JournalRecord);
+        for (size_t i = 0; i < count; i++) {
+            if (chunk[i].crc != RecordCrc(chunk[i])) {
+                torn = true;
+                break;
+            }
+            replay(chunk[i]);
+            records++;
+            offset += sizeof(JournalRecord);
+        }
+        if (count < chunk.size()) break;
+    }
+
+    if (offset < info.st_size) {
+        std::cerr << "Journal " << path << ": discarding " << (info.st_size - offset)
+                  << " bytes after the last intact record" << std::endl;
+        if (ftruncate(fd, offset) != 0) {
+            std::cerr << "Failed to truncate journal " << path << ": " << strerror(errno) << std::endl;
+            return false;
+        }
+    }
+    lseek(fd, offset, SEEK_SET);
+    replayed = records;
+    return true;
+}
+
+void Journal::Close() {
+    if (writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        writer.join();
+    }
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+void Journal::Append(uint32_t type, int32_t horse, int64_t amount) {
+    JournalRecord record = MakeRecord(type, horse, amount);
+
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back(record);
+        // The first record starts the writer's commit interval; a full batch ends it
+        wake = pending.size() == 1 || pending.size() == JOURNAL_COMMIT_BATCH;
+    }
+    if (wake) condition.notify_one();
+}
+
+void Journal::Checkpoint(const std::vector<long long>& contributions, const std::vector<long long>& previousResults) {
+    JournalRecord record = MakeRecord(JOURNAL_RACE_RESULT, -1, 0);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back(record);
+        checkpointAt = pending.size();
+        checkpointContributions.assign(contributions.begin(), contributions.end());
+        checkpointResults.assign(previousResults.begin(), previousResults.end());
+        checkpointPending = true;
+    }
+    condition.notify_one();
+}
+
+// Write the snapshot and the records after it to a new file and rename it
+// over the journal. On failure the old journal stays in use.
+bool Journal::Compact(const std::vector<long long>& contributions, const std::vector<long long>& previousResults,
+                      const JournalRecord* after, size_t afterCount) {
+    int out = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0) return false;
+
+    // Replaying this gives back both arrays: the result first, then what was added since
+    JournalRecord chunk[1024];
+    size_t chunkSize = 0;
+    bool ok = WriteHeader(out, numHorses);
+    auto add = [&](const JournalRecord& record) {
+        chunk[chunkSize++] = record;
+        if (chunkSize == sizeof(chunk) / sizeof(chunk[0])) {
+            ok = ok && WriteAll(out, chunk, sizeof(chunk));
+            chunkSize = 0;
+        }
+    };
+    for (size_t horse = 0; horse < previousResults.size(); horse++) {
+        if (previousResults[horse] != 0) add(MakeRecord(JOURNAL_CONTRIBUTION, (int32_t)horse, previousResults[horse]));
+    }
+    add(MakeRecord(JOURNAL_RACE_RESULT, -1, 0));
+    for (size_t horse = 0; horse < contributions.size(); horse++) {
+        long long added = contributions[horse] - (horse < previousResults.size() ? previousResults[horse] : 0);
+        if (added != 0) add(MakeRecord(JOURNAL_CONTRIBUTION, (int32_t)horse, added));
+    }
+    ok = ok && WriteAll(out, chunk, chunkSize * sizeof(JournalRecord));
+    ok = ok && WriteAll(out, after, afterCount * sizeof(JournalRecord));
+
+    // The new file must be complete on disk before it replaces the old one
+    if (ok && sync == JOURNAL_SYNC_BATCH) ok = fsync(out) == 0;
+    if (ok) ok = rename(temporaryPath.c_str(), path.c_str()) == 0;
+    if (!ok) {
+        int error = errno;
+        close(out);
+        unlink(temporaryPath.c_str());
+        errno = error;
+        return false;
+    }
+    if (sync == JOURNAL_SYNC_BATCH) SyncDirectory(path);
+    close(fd);
+    fd = out;
+    return true;
+}
+
+void Journal::WriterLoop() {
+    std::vector<JournalRecord> writing;
+    writing.reserve(JOURNAL_COMMIT_BATCH);
+    std::vector<long long> contributions;
+    std::vector<long long> previousResults;
+    bool failed = false;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        // Sleep until there is something to write, then give the rest of the
+        // group one commit interval to arrive
+        condition.wait(lock, [this]() { return stopping || !pending.empty(); });
+        if (pending.empty()) break;
+        condition.wait_for(lock, std::chrono::milliseconds(commitIntervalMs), [this]() {
+            return stopping || checkpointPending || pending.size() >= JOURNAL_COMMIT_BATCH;
+        });
+        writing.swap(pending);
+        bool compact = checkpointPending;
+        size_t head = compact ? checkpointAt : writing.size();
+        if (compact) {
+            contributions.swap(checkpointContributions);
+            previousResults.swap(checkpointResults);
+            checkpointPending = false;
+        }
+        lock.unlock();
+
+        // One write (and at most one sync) for the whole group. Records up to a
+        // checkpoint go to the old journal first, so it is complete until the
+        // new one has replaced it.
+        bool ok = WriteAll(fd, writing.data(), head * sizeof(JournalRecord));
+        if (ok && sync == JOURNAL_SYNC_BATCH) ok = fdatasync(fd) == 0;
+        if (ok && compact && !Compact(contributions, previousResults, writing.data() + head, writing.size() - head)) {
+            std::cerr << "Failed to compact journal " << path << ": " << strerror(errno) << "; appending to it instead" << std::endl;
+            ok = WriteAll(fd, writing.data() + head, (writing.size() - head) * sizeof(JournalRecord));
+            if (ok && sync == JOURNAL_SYNC_BATCH) ok = fdatasync(fd) == 0;
+        }
+        if (!ok && !failed) {
+            std::cerr << "Journal write failed: " << strerror(errno) << "; later contributions may be lost on a crash" << std::endl;
+            failed = true;
+        }
+        writing.clear();
+
+        lock.lock();
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Append-only log of everything that changes the totals, for crash recovery.
+// Nothing in here depends on SDL.
+//
+// File layout: a JournalHeader, then fixed-size JournalRecords, each carrying a
+// CRC-32 of the rest of the record. Append() only queues a record; a writer
+// thread sleeps until one is queued, then commits everything that arrives
+// within one commit interval (or sooner when a batch fills up) in one write()
+// and, depending on the sync policy, fsyncs it.
+// On open, records are replayed up to the first one that fails its checksum
+// and the torn tail after it is cut off.
+//
+// Every race result is a checkpoint: the writer rewrites the journal as the
+// totals at that point (one record per horse with a nonzero total, and the
+// result) followed by whatever came after, in a new file renamed over the old
+// one. A crash leaves either journal intact, and recovery replays one
+// snapshot plus the current race instead of every contribution ever made.
+
+const char JOURNAL_MAGIC[4] = {'E', 'Q', 'J', 'N'};
+const uint32_t JOURNAL_VERSION = 1;
+const int DEFAULT_JOURNAL_INTERVAL_MS = 5;
+const size_t JOURNAL_COMMIT_BATCH = 4096;   // Records that trigger a commit before the interval is up
+
+enum JournalRecordType : uint32_t {
+    JOURNAL_CONTRIBUTION = 1,   // amount added to horse
+    JOURNAL_RACE_RESULT = 2,    // the current totals became the race result
+};
+
+enum JournalSync {
+    JOURNAL_SYNC_NONE,          // write() only; survives a crash of the process, not of the machine
+    JOURNAL_SYNC_BATCH,         // fdatasync() after every commit
+};
+
+struct JournalHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t numHorses;         // Field size when the journal was created
+    uint32_t reserved;
+};
+
+struct JournalRecord {
+    uint32_t crc;               // CRC-32 of the bytes after this field
+    uint32_t type;
+    int32_t horse;
+    uint32_t reserved;
+    int64_t amount;
+};
+
+static_assert(sizeof(JournalHeader) == 16, "JournalHeader layout is part of the file format");
+static_assert(sizeof(JournalRecord) == 24, "JournalRecord layout is part of the file format");
+
+class Journal {
+public:
+    Journal();
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // Create or reopen path. Existing records are passed to replay in order
+    // before the journal accepts new ones. Returns false if the file cannot be
+    // opened or is not a journal.
+    bool Open(const std::string& path, int numHorses, JournalSync sync, int commitIntervalMs,
+              const std::function<void(const JournalRecord&)>& replay);
+
+    // Commit everything queued and stop the writer
+    void Close();
+
+    bool IsOpen() const { return writer.joinable(); }
+
+    // Queue a record for the next commit. Cheap; never touches the file.
+    void Append(uint32_t type, int32_t horse, int64_t amount);
+
+    // Queue a JOURNAL_RACE_RESULT and compact the journal down to the totals
+    // it leaves: contributions, with previousResults as the race result. Copies
+    // both arrays; the rewrite happens on the writer thread.
+    void Checkpoint(const std::vector<long long>& contributions, const std::vector<long long>& previousResults);
+
+    long long ReplayedRecords() const { return replayed; }
+
+private:
+    bool Replay(const std::string& path, int numHorses, const std::function<void(const JournalRecord&)>& replay);
+    void WriterLoop();
+    bool Compact(const std::vector<long long>& contributions, const std::vector<long long>& previousResults,
+                 const JournalRecord* after, size_t afterCount);
+
+    std::string path;
+    std::string temporaryPath;  // Compacted journal before it is renamed over path
+    int fd;                     // Only the writer thread touches it while open
+    uint32_t numHorses;
+    JournalSync sync;
+    int commitIntervalMs;
+    long long replayed;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<JournalRecord> pending;   // Queued by Append(), taken by the writer
+    bool checkpointPending;
+    size_t checkpointAt;                  // Records of pending up to and including the race result
+    std::vector<long long> checkpointContributions;
+    std::vector<long long> checkpointResults;
+    bool stopping;
+    std::thread writer;
+};
+
+uint32_t Crc32(const void* data, size_t length);
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Bounded lock-free multi-producer / single-consumer ring.
+// Producers claim a slot with one compare-exchange on the tail and never wait
+// for each other to finish writing; each slot's sequence number tells the
+// consumer when its value is ready. TryPush() fails instead of blocking when
+// the ring is full.
+template <typename T>
+class MpscQueue {
+public:
+    // capacity is rounded up to a power of two
+    explicit MpscQueue(size_t capacity) : tail(0), head(0) {
+        size_t size = 2;
+        while (size < capacity) size *= 2;
+        slots.reset(new Slot[size]);
+        mask = size - 1;
+        for (size_t i = 0; i < size; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    // Producer side, any thread
+    bool TryPush(const T& value) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots[pos & mask];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false; // Full: the consumer has not freed this slot yet
+            } else {
+                pos = tail.load(std::memory_order_relaxed); // Another producer took it
+            }
+        }
+        slot->value = value;
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side, one thread at a time
+    bool TryPop(T& value) {
+        Slot& slot = slots[head & mask];
+        if (slot.sequence.load(std::memory_order_acquire) != head + 1) return false;
+        value = slot.value;
+        slot.sequence.store(head + mask + 1, std::memory_order_release);
+        head++;
+        return true;
+    }
+
+    // Pop up to max values into consume(const T&). Returns how many were taken.
+    template <typename F>
+    size_t Drain(size_t max, F&& consume) {
+        size_t count = 0;
+        T value;
+        while (count < max && TryPop(value)) {
+            consume(value);
+            count++;
+        }
+        return count;
+    }
+
+    size_t Capacity() const { return mask + 1; }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;  // pos + 1 once written at pos; pos + capacity once free again
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> tail;  // Next position to claim, shared by producers
+    alignas(64) size_t head;               // Owned by the consumer
+};
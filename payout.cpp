@@ -0,0 +1,109 @@
+#include "payout.h"
+#include <algorithm>
+
+const uint32_t NO_STAKE = UINT32_MAX;
+
+void BetBook::Reset(int numHorses) {
+    bettors.clear();
+    horses.clear();
+    amounts.clear();
+    nextStakes.clear();
+    horseTotals.assign(numHorses, 0);
+    total = 0;
+    race++;
+    bettorCount = 0;
+}
+
+void BetBook::Reserve(size_t stakes) {
+    bettors.reserve(stakes);
+    horses.reserve(stakes);
+    amounts.reserve(stakes);
+    nextStakes.reserve(stakes);
+}
+
+uint32_t BetBook::AddStake(uint32_t bettor, int horse) {
+    bettors.push_back(bettor);
+    horses.push_back((uint32_t)horse);
+    amounts.push_back(0);
+    nextStakes.push_back(NO_STAKE);
+    return (uint32_t)(amounts.size() - 1);
+}
+
+void BetBook::Add(BetSlot& slot, int horse, long long amount) {
+    if (slot.race != race) {
+        // First bet of this race
+        slot.race = race;
+        slot.bettor = bettorCount++;
+        slot.firstStake = slot.stake = AddStake(slot.bettor, horse);
+        slot.horse = horse;
+    } else if (slot.horse != horse) {
+        uint32_t stake = slot.firstStake;
+        uint32_t last = stake;
+        while (stake != NO_STAKE && horses[stake] != (uint32_t)horse) {
+            last = stake;
+            stake = nextStakes[stake];
+        }
+        if (stake == NO_STAKE) {
+            stake = AddStake(slot.bettor, horse);
+            nextStakes[last] = stake;
+        }
+        slot.stake = stake;
+        slot.horse = horse;
+    }
+    amounts[slot.stake] += amount;
+    horseTotals[horse] += amount;
+    total += amount;
+}
+
+void SettleRace(const BetBook& book, const size_t* places, int placeCount, const PayoutRules& rules, Settlement& settlement) {
+    settlement.rates.assign(book.HorseCount(), 0.0);
+    settlement.awards.assign(book.HorseCount(), 0);
+    settlement.prizeAwarded = 0;
+    settlement.poolAwarded = 0;
+    settlement.unclaimed = 0;
+
+    // Fixed prizes, scaled down together if they add up to more than the cap
+    int prizePlaces = std::min(placeCount, (int)rules.placePrizes.size());
+    long long prizeTotal = 0;
+    for (int i = 0; i < prizePlaces; i++) prizeTotal += rules.placePrizes[i];
+    double prizeScale = rules.prizeCap > 0 && prizeTotal > rules.prizeCap ? (double)rules.prizeCap / prizeTotal : 1.0;
+
+    long long pool = (long long)(book.Total() * (1.0 - rules.takeout));
+    int poolPlaces = std::min(placeCount, (int)rules.poolShares.size());
+
+    for (int i = 0; i < std::max(prizePlaces, poolPlaces); i++) {
+        long long prize = i < prizePlaces ? (long long)(rules.placePrizes[i] * prizeScale) : 0;
+        long long share = i < poolPlaces ? (long long)(pool * rules.poolShares[i]) : 0;
+        long long staked = book.HorseTotal((int)places[i]);
+        if (staked == 0) {
+            settlement.unclaimed += prize + share;
+            continue;
+        }
+        settlement.prizeAwarded += prize;
+        settlement.poolAwarded += share;
+        settlement.awards[places[i]] += prize + share;
+        settlement.rates[places[i]] += (double)(prize + share) / staked;
+    }
+
+    // One branch-free pass over the stakes
+    size_t count = book.Size();
+    settlement.payouts.resize(count);
+    const uint32_t* horses = book.Horses();
+    const long long* amounts = book.Amounts();
+    const double* rates = settlement.rates.data();
+    long long* payouts = settlement.payouts.data();
+    for (size_t i = 0; i < count; i++) {
+        payouts[i] = (long long)(amounts[i] * rates[horses[i]]);
+    }
+    long long paid = 0;
+    for (size_t i = 0; i < count; i++) paid += payouts[i];
+    settlement.paid = paid;
+
+    // Per-bettor totals; scattered writes, so only the stakes that won
+    settlement.bettorPayouts.assign(book.BettorCount(), 0);
+    const uint32_t* bettors = book.Bettors();
+    long long* bettorPayouts = settlement.bettorPayouts.data();
+    for (size_t i = 0; i < count; i++) {
+        if (payouts[i] != 0) bettorPayouts[bettors[i]] += payouts[i];
+    }
+}
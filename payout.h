@@ -0,0 +1,103 @@
+#pragma once
+
+// Per-bettor bets and race settlement. Nothing in here depends on SDL.
+//
+// Bets are kept as stakes, one per bettor and horse, in a structure of
+// arrays (bettor, horse and amount each in their own flat array). Repeated
+// bets on the same horse add to the bettor's stake, so the arrays grow with
+// the number of bettors, not of contributions. Every stake on a horse pays
+// the same amount per yen, so settling prices the placed horses first and
+// then pays each stake with one multiply by its horse's rate, in a single
+// branch-free pass.
+
+#include "race_core.h"
+#include <cstdint>
+#include <vector>
+
+// How a race pays out. Fixed prizes and the pari-mutuel pool can be combined;
+// each place's share goes to the backers of the horse finishing there, in
+// proportion to their stakes.
+//
+// The defaults pay the PRIZE_DISTRIBUTION tiers (2億, 1億, 1億) in full with
+// no cap, so a default race pays exactly those amounts. PRIZE_CAP (3億) is
+// not applied: it is below the tiers' 4億 sum and would scale every payout
+// down by a quarter.
+struct PayoutRules {
+    std::vector<long long> placePrizes;   // Fixed prize for each finishing place, best first
+    long long prizeCap;                   // Most paid in fixed prizes per race; more is scaled down (0 = no cap)
+    std::vector<double> poolShares;       // Fraction of the pool for each place, best first (empty = no pool)
+    double takeout;                       // Fraction of the pool kept before it is shared out
+
+    PayoutRules() : placePrizes(PRIZE_DISTRIBUTION), prizeCap(0), takeout(0) {}
+};
+
+// Where one bettor's stakes are in a BetBook. Every bettor (a connection,
+// the race simulation) keeps one; it goes stale by itself when the book is
+// reset, and the bettor gets a new id with its first bet of the next race.
+struct BetSlot {
+    uint64_t race;          // BetBook::Race() the rest belongs to
+    uint32_t bettor;        // Id in that race, 0 .. BettorCount() - 1
+    uint32_t firstStake;    // The bettor's stakes are linked from here
+    uint32_t stake;         // Stake last added to, on horse
+    int horse;
+
+    BetSlot() : race(0), bettor(0), firstStake(0), stake(0), horse(-1) {}
+};
+
+// Every stake of one race
+class BetBook {
+public:
+    explicit BetBook(int numHorses = 0) : race(0) { Reset(numHorses); }
+
+    // Forget all stakes and start the next race; the arrays keep their capacity
+    void Reset(int numHorses);
+    void Reserve(size_t stakes);
+
+    // Add amount to slot's stake on horse. Repeated bets on one horse cost
+    // O(1); switching horses walks the bettor's other stakes.
+    void Add(BetSlot& slot, int horse, long long amount);
+
+    // Whether slot has bet in the current race
+    bool HasBets(const BetSlot& slot) const { return slot.race == race; }
+
+    uint64_t Race() const { return race; }
+    size_t Size() const { return amounts.size(); }
+    int HorseCount() const { return (int)horseTotals.size(); }
+    uint32_t BettorCount() const { return bettorCount; }
+    const uint32_t* Bettors() const { return bettors.data(); }
+    const uint32_t* Horses() const { return horses.data(); }
+    const long long* Amounts() const { return amounts.data(); }
+
+    long long HorseTotal(int horse) const { return horseTotals[horse]; }
+    long long Total() const { return total; }
+
+private:
+    uint32_t AddStake(uint32_t bettor, int horse);
+
+    std::vector<uint32_t> bettors;
+    std::vector<uint32_t> horses;
+    std::vector<long long> amounts;
+    std::vector<uint32_t> nextStakes;   // Next stake of the same bettor; only walked when it switches horses
+    std::vector<long long> horseTotals;
+    long long total;
+    uint64_t race;
+    uint32_t bettorCount;
+};
+
+// Result of SettleRace(). Reuse one across races to keep its arrays.
+struct Settlement {
+    std::vector<double> rates;            // Paid per yen staked, by horse
+    std::vector<long long> awards;        // Given to each horse's backers, by horse, before rounding
+    std::vector<long long> payouts;       // By stake, in book order
+    std::vector<long long> bettorPayouts; // By bettor id (BetSlot::bettor)
+    long long prizeAwarded;               // Fixed prizes given to placed horses with backers, after the cap
+    long long poolAwarded;                // Pool after takeout given to placed horses with backers
+    long long unclaimed;                  // Prizes and pool shares for places nobody backed
+    long long paid;                       // Sum of payouts; each is rounded down, the rest stays with the house
+
+    Settlement() : prizeAwarded(0), poolAwarded(0), unclaimed(0), paid(0) {}
+};
+
+// Pay out the stakes in book. places[0..placeCount) are the finishing horses,
+// winner first (for example from Leaderboard::Top()).
+void SettleRace(const BetBook& book, const size_t* places, int placeCount, const PayoutRules& rules, Settlement& settlement);
@@ -0,0 +1,59 @@
+// Pins what the default PayoutRules pay for a known race, so a change to the
+// defaults (tiers, cap, pool) shows up as a failure instead of a silent
+// change in every payout. Exits non-zero on the first mismatch.
+//
+//   ./payout_test
+
+#include "payout.h"
+#include <iostream>
+
+static int failures = 0;
+
+static void Expect(const char* what, long long actual, long long expected) {
+    if (actual == expected) return;
+    std::cerr << "FAIL " << what << ": " << actual << ", expected " << expected << std::endl;
+    failures++;
+}
+
+int main() {
+    // Horses 0, 1, 2 finish in that order; horse 3 is unplaced
+    const int numHorses = 4;
+    BetBook book(numHorses);
+    BetSlot a, b, c, d, e;
+    book.Add(a, 0, 1000);
+    book.Add(b, 0, 1000);
+    book.Add(b, 0, 2000);           // Same stake as b's first bet
+    book.Add(c, 1, 2000);
+    book.Add(d, 2, 5000);
+    book.Add(e, 3, 1000);
+    const size_t places[] = {0, 1, 2};
+
+    PayoutRules rules;
+    Settlement settlement;
+    SettleRace(book, places, 3, rules, settlement);
+
+    Expect("stakes", (long long)book.Size(), 5);
+    Expect("bettors", book.BettorCount(), 5);
+    // The tiers are paid in full: 2億 to horse 0, 1億 each to horses 1 and 2
+    Expect("winner's backer a", settlement.bettorPayouts[a.bettor], 50000000);
+    Expect("winner's backer b", settlement.bettorPayouts[b.bettor], 150000000);
+    Expect("second's backer c", settlement.bettorPayouts[c.bettor], 100000000);
+    Expect("third's backer d", settlement.bettorPayouts[d.bettor], 100000000);
+    Expect("unplaced backer e", settlement.bettorPayouts[e.bettor], 0);
+    Expect("prize awarded", settlement.prizeAwarded, 400000000);
+    Expect("pool awarded", settlement.poolAwarded, 0);
+    Expect("unclaimed", settlement.unclaimed, 0);
+    Expect("paid", settlement.paid, 400000000);
+
+    // A place nobody backed keeps its prize
+    BetBook unbacked(numHorses);
+    BetSlot f;
+    unbacked.Add(f, 1, 1000);
+    SettleRace(unbacked, places, 3, rules, settlement);
+    Expect("unbacked winner, second's backer", settlement.bettorPayouts[f.bettor], 100000000);
+    Expect("unbacked winner, unclaimed", settlement.unclaimed, 300000000);
+
+    if (failures > 0) return 1;
+    std::cout << "Default payouts OK" << std::endl;
+    return 0;
+}
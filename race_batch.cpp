@@ -0,0 +1,229 @@
+// Monte Carlo batch simulator for payout tuning.
+// Runs many races across all cores without a window and reports the win
+// distribution, prize statistics and throughput.
+//
+//   ./race_batch [--races N] [--threads N] [--horses N] [--seconds N] [--seed N] [--history FILE]
+//
+// With --history every simulated race is also appended to a race history
+// file, for trying out historical queries on millions of races.
+
+#include "race_core.h"
+#include "race_history.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct BatchStats {
+    long long races;
+    std::vector<long long> wins;
+    double prizeMean;
+    double prizeM2;       // Sum of squared deviations (Welford)
+    long long prizeMin;
+    long long prizeMax;
+    long long cappedRaces;
+    long long tiedWins;   // Races where the lead was shared; the lower index wins
+
+    explicit BatchStats(int numHorses) :
+        races(0),
+        wins(numHorses, 0),
+        prizeMean(0),
+        prizeM2(0),
+        prizeMin(PRIZE_CAP),
+        prizeMax(0),
+        cappedRaces(0),
+        tiedWins(0) {}
+
+    void AddPrize(long long prize) {
+        races++;
+        double delta = (double)prize - prizeMean;
+        prizeMean += delta / races;
+        prizeM2 += delta * ((double)prize - prizeMean);
+        prizeMin = std::min(prizeMin, prize);
+        prizeMax = std::max(prizeMax, prize);
+        if (prize >= PRIZE_CAP) cappedRaces++;
+    }
+
+    void Merge(const BatchStats& other) {
+        if (other.races == 0) return;
+        long long combined = races + other.races;
+        double delta = other.prizeMean - prizeMean;
+        prizeMean += delta * other.races / combined;
+        prizeM2 += other.prizeM2 + delta * delta * ((double)races * other.races / combined);
+        races = combined;
+        for (size_t i = 0; i < wins.size(); i++) {
+            wins[i] += other.wins[i];
+        }
+        prizeMin = std::min(prizeMin, other.prizeMin);
+        prizeMax = std::max(prizeMax, other.prizeMax);
+        cappedRaces += other.cappedRaces;
+        tiedWins += other.tiedWins;
+    }
+};
+
+const int HISTORY_BATCH = 1024;   // Races a thread collects before taking the history lock
+
+// Results of some races in the layout RaceHistory::Append() takes
+struct HistoryBatch {
+    int numHorses;
+    int races;
+    std::vector<long long> prizes;
+    std::vector<long long> contributions;   // numHorses per race
+    std::vector<long long> payouts;
+    std::vector<uint32_t> finish;
+
+    explicit HistoryBatch(int numHorses) : numHorses(numHorses), races(0), prizes(HISTORY_BATCH),
+        contributions((size_t)numHorses * HISTORY_BATCH), payouts((size_t)numHorses * HISTORY_BATCH),
+        finish((size_t)numHorses * HISTORY_BATCH) {}
+
+    void Add(const std::vector<long long>& raceContributions) {
+        size_t offset = (size_t)races * numHorses;
+        std::vector<size_t> ranking = RankHorses(raceContributions);
+        long long shares[PRIZE_PLACES];
+        int placed = std::min(numHorses, PRIZE_PLACES);
+        PrizeShares(raceContributions, ranking.data(), placed, shares);
+
+        prizes[races] = CalculatePrize(raceContributions);
+        std::copy(raceContributions.begin(), raceContributions.end(), contributions.begin() + offset);
+        std::fill(payouts.begin() + offset, payouts.begin() + offset + numHorses, 0);
+        for (int place = 0; place < numHorses; place++) finish[offset + ranking[place]] = (uint32_t)place;
+        for (int place = 0; place < placed; place++) payouts[offset + ranking[place]] = shares[place];
+        races++;
+    }
+
+    bool Full() const { return races == HISTORY_BATCH; }
+
+    void Flush(RaceHistory& history, std::mutex& lock) {
+        int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        std::lock_guard<std::mutex> guard(lock);
+        for (int i = 0; i < races; i++) {
+            size_t offset = (size_t)i * numHorses;
+            RaceHistoryRow row;
+            row.timeMs = now;
+            row.seed = 0; // Races share one stream per thread; no per-race seed
+            row.prize = prizes[i];
+            row.contributions = &contributions[offset];
+            row.payouts = &payouts[offset];
+            row.finish = &finish[offset];
+            history.Append(row);
+        }
+        races = 0;
+    }
+};
+
+static void RunBatch(const RaceConfig& config, long long races, unsigned long long seed, int streamIndex, BatchStats& result,
+                     RaceHistory* history, std::mutex* historyLock) {
+    // Independent stream per thread: same seed, different stream index
+    std::seed_seq seq{(unsigned)(seed >> 32), (unsigned)seed, (unsigned)streamIndex};
+    RaceRng rng(seq);
+
+    // Accumulate locally so threads never write to neighbouring cache lines
+    BatchStats stats(config.numHorses);
+
+    std::vector<long long> contributions;
+    HistoryBatch batch(history ? config.numHorses : 0);
+    for (long long r = 0; r < races; r++) {
+        SimulateRaceInstant(config, rng, contributions);
+
+        size_t top[2];
+        int placed = TopHorses(contributions, top, 2);
+        stats.wins[top[0]]++;
+        if (placed > 1 && contributions[top[0]] == contributions[top[1]]) stats.tiedWins++;
+
+        stats.AddPrize(CalculatePrize(contributions));
+
+        if (history) {
+            batch.Add(contributions);
+            if (batch.Full()) batch.Flush(*history, *historyLock);
+        }
+    }
+    if (history) batch.Flush(*history, *historyLock);
+    result = stats;
+}
+
+int main(int argc, char* argv[]) {
+    RaceConfig config;
+    long long races = 1000000;
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    unsigned long long seed = std::random_device{}();
+    std::string historyPath;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--races") && hasValue) {
+            races = std::atoll(argv[++i]);
+        } else if (!strcmp(argv[i], "--threads") && hasValue) {
+            threads = std::max(1, std::atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--horses") && hasValue) {
+            config.numHorses = std::max(1, std::atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--seconds") && hasValue) {
+            config.durationSeconds = std::max(1, std::atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--seed") && hasValue) {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--history") && hasValue) {
+            historyPath = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--races N] [--threads N] [--horses N] [--seconds N] [--seed N] [--history FILE]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "Simulating " << races << " races (" << config.numHorses << " horses, "
+              << config.durationSeconds << "s, " << SimulatedContributionCount(config.durationSeconds)
+              << " contributions each) on " << threads << " threads, seed " << seed << std::endl;
+
+    RaceHistory history;
+    std::mutex historyLock;
+    if (!historyPath.empty() && !history.Open(historyPath, config.numHorses)) return 1;
+    RaceHistory* historyTarget = history.IsOpen() ? &history : nullptr;
+
+    std::vector<BatchStats> perThread(threads, BatchStats(config.numHorses));
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; t++) {
+        long long share = races / threads + (t < races % threads ? 1 : 0);
+        workers.emplace_back(RunBatch, std::cref(config), share, seed, t, std::ref(perThread[t]), historyTarget, &historyLock);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    BatchStats total(config.numHorses);
+    for (const auto& stats : perThread) {
+        total.Merge(stats);
+    }
+    if (total.races == 0) {
+        std::cout << "No races simulated." << std::endl;
+        return 0;
+    }
+
+    double mean = total.prizeMean;
+    double variance = total.prizeM2 / total.races;
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "\nWin distribution:" << std::endl;
+    for (int i = 0; i < config.numHorses; i++) {
+        std::cout << "  Horse " << std::setw(2) << i + 1 << ": "
+                  << std::setw(8) << 100.0 * total.wins[i] / total.races << "%" << std::endl;
+    }
+    std::cout << "  Shared lead: " << 100.0 * total.tiedWins / total.races << "%" << std::endl;
+    std::cout << "\nPrize:" << std::endl;
+    std::cout << "  mean:   " << FormatMoney((long long)mean) << std::endl;
+    std::cout << "  stddev: " << FormatMoney((long long)std::sqrt(variance)) << std::endl;
+    std::cout << "  min:    " << FormatMoney(total.prizeMin) << std::endl;
+    std::cout << "  max:    " << FormatMoney(total.prizeMax) << std::endl;
+    std::cout << "  capped: " << 100.0 * total.cappedRaces / total.races << "%" << std::endl;
+    std::cout << "\nThroughput: " << std::setprecision(0) << total.races / seconds << " races/s ("
+              << std::setprecision(3) << seconds << "s)" << std::endl;
+    if (history.IsOpen()) {
+        std::cout << "History: " << history.RaceCount() << " races in " << historyPath << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,255 @@
+#include "race_core.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <numeric>
+
+size_t FormatMoney(long long amount, char* buffer, size_t size) {
+    if (size < MONEY_TEXT_MAX) return 0;
+    char* end = buffer + size;
+    char* out = buffer;
+    auto append = [&out](const char* text) {
+        size_t length = strlen(text);
+        memcpy(out, text, length);
+        out += length;
+    };
+    if (amount >= 100000000) {
+        long long man = (amount % 100000000) / 10000;
+        out = std::to_chars(out, end, amount / 100000000).ptr;
+        if (man == 0) {
+            append("億円");
+        } else {
+            append("億");
+            out = std::to_chars(out, end, man).ptr;
+            append("万円");
+        }
+    } else if (amount >= 10000) {
+        out = std::to_chars(out, end, amount / 10000).ptr;
+        append("万円");
+    } else {
+        out = std::to_chars(out, end, amount).ptr;
+        append("円");
+    }
+    return out - buffer;
+}
+
+std::string FormatMoney(long long amount) {
+    char buffer[MONEY_TEXT_MAX];
+    return std::string(buffer, FormatMoney(amount, buffer, sizeof(buffer)));
+}
+
+std::vector<size_t> RankHorses(const std::vector<long long>& contributions) {
+    std::vector<size_t> indices(contributions.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    std::stable_sort(indices.begin(), indices.end(),
+                     [&contributions](size_t a, size_t b) {
+                         return contributions[a] > contributions[b];
+                     });
+    return indices;
+}
+
+int TopHorses(const std::vector<long long>& contributions, size_t* top, int count) {
+    int filled = 0;
+    for (size_t i = 0; i < contributions.size(); i++) {
+        // Insertion into the small sorted prefix; strict > keeps ties in index order
+        int pos = filled;
+        while (pos > 0 && contributions[i] > contributions[top[pos - 1]]) {
+            pos--;
+        }
+        if (pos >= count) continue;
+        int last = std::min(filled, count - 1);
+        for (int j = last; j > pos; j--) {
+            top[j] = top[j - 1];
+        }
+        top[pos] = i;
+        if (filled < count) filled++;
+    }
+    return filled;
+}
+
+long long CalculatePrize(const std::vector<long long>& contributions) {
+    size_t top[PRIZE_PLACES];
+    int places = TopHorses(contributions, top, PRIZE_PLACES);
+
+    long long totalPrize = 0;
+    for (int i = 0; i < places; i++) {
+        totalPrize += contributions[top[i]];
+    }
+    return std::min(totalPrize, PRIZE_CAP);
+}
+
+void PrizeShares(const std::vector<long long>& contributions, const size_t* top, int count, long long* shares) {
+    long long total = 0;
+    for (int i = 0; i < count; i++) total += contributions[top[i]];
+    double scale = total > PRIZE_CAP ? (double)PRIZE_CAP / total : 1.0;
+    for (int i = 0; i < count; i++) shares[i] = (long long)(contributions[top[i]] * scale);
+}
+
+// Treap priority of a horse: a fixed hash of its index, so rankings are
+// rebuilt the same way every time
+static uint32_t HorsePriority(uint32_t horse) {
+    uint64_t x = horse + 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return (uint32_t)(x ^ (x >> 31));
+}
+
+void Leaderboard::Rebuild(const std::vector<long long>& contributions) {
+    size_t numHorses = contributions.size();
+    keys = contributions;
+    priorities.resize(numHorses);
+    left.assign(numHorses, NO_HORSE);
+    right.assign(numHorses, NO_HORSE);
+    counts.assign(numHorses, 1);
+    for (size_t horse = 0; horse < numHorses; horse++) priorities[horse] = HorsePriority((uint32_t)horse);
+
+    // Build the treap from the ranking in one pass: the stack holds the
+    // right spine, and each horse takes the part of it it outranks in priority
+    std::vector<size_t> order = RankHorses(contributions);
+    std::vector<uint32_t> spine;
+    spine.reserve(64);
+    for (size_t i = 0; i < numHorses; i++) {
+        uint32_t horse = (uint32_t)order[i];
+        uint32_t last = NO_HORSE;
+        while (!spine.empty() && priorities[spine.back()] < priorities[horse]) {
+            last = spine.back();
+            spine.pop_back();
+            Recount(last);
+        }
+        left[horse] = last;
+        if (!spine.empty()) right[spine.back()] = horse;
+        spine.push_back(horse);
+    }
+    while (spine.size() > 1) {
+        Recount(spine.back());
+        spine.pop_back();
+    }
+    root = spine.empty() ? NO_HORSE : spine[0];
+    if (root != NO_HORSE) Recount(root);
+}
+
+void Leaderboard::Split(uint32_t node, uint32_t horse, uint32_t& ahead, uint32_t& behind) {
+    if (node == NO_HORSE) {
+        ahead = behind = NO_HORSE;
+    } else if (Ahead(node, horse)) {
+        Split(right[node], horse, right[node], behind);
+        ahead = node;
+        Recount(node);
+    } else {
+        Split(left[node], horse, ahead, left[node]);
+        behind = node;
+        Recount(node);
+    }
+}
+
+uint32_t Leaderboard::Merge(uint32_t ahead, uint32_t behind) {
+    if (ahead == NO_HORSE) return behind;
+    if (behind == NO_HORSE) return ahead;
+    if (priorities[ahead] > priorities[behind]) {
+        right[ahead] = Merge(right[ahead], behind);
+        Recount(ahead);
+        return ahead;
+    }
+    left[behind] = Merge(ahead, left[behind]);
+    Recount(behind);
+    return behind;
+}
+
+// Take horse out of the subtree at node, found by its current key
+uint32_t Leaderboard::Remove(uint32_t node, uint32_t horse) {
+    if (node == horse) return Merge(left[node], right[node]);
+    if (Ahead(horse, node)) {
+        left[node] = Remove(left[node], horse);
+    } else {
+        right[node] = Remove(right[node], horse);
+    }
+    Recount(node);
+    return node;
+}
+
+void Leaderboard::Update(const std::vector<long long>& contributions, size_t horse) {
+    uint32_t moved = (uint32_t)horse;
+    if (keys[moved] == contributions[horse]) return;
+    root = Remove(root, moved);
+    keys[moved] = contributions[horse];
+    left[moved] = right[moved] = NO_HORSE;
+    counts[moved] = 1;
+    uint32_t ahead, behind;
+    Split(root, moved, ahead, behind);
+    root = Merge(Merge(ahead, moved), behind);
+}
+
+size_t Leaderboard::HorseAt(size_t place) const {
+    uint32_t node = root;
+    while (true) {
+        uint32_t before = Count(left[node]);
+        if (place == before) return node;
+        if (place < before) {
+            node = left[node];
+        } else {
+            place -= before + 1;
+            node = right[node];
+        }
+    }
+}
+
+size_t Leaderboard::PlaceOf(size_t horse) const {
+    size_t place = 0;
+    uint32_t node = root;
+    while (node != horse) {
+        if (Ahead((uint32_t)horse, node)) {
+            node = left[node];
+        } else {
+            place += Count(left[node]) + 1;
+            node = right[node];
+        }
+    }
+    return place + Count(left[node]);
+}
+
+int Leaderboard::Top(size_t* top, int count) const {
+    int filled = (int)std::min(Size(), (size_t)std::max(count, 0));
+    for (int i = 0; i < filled; i++) top[i] = HorseAt(i);
+    return filled;
+}
+
+long long Leaderboard::Prize(const std::vector<long long>& contributions) const {
+    size_t top[PRIZE_PLACES];
+    int places = Top(top, PRIZE_PLACES);
+    long long totalPrize = 0;
+    for (int i = 0; i < places; i++) {
+        totalPrize += contributions[top[i]];
+    }
+    return std::min(totalPrize, PRIZE_CAP);
+}
+
+void PoolOdds::Rebuild(const std::vector<long long>& contributions) {
+    total = 0;
+    for (long long amount : contributions) total += amount;
+}
+
+int SimulatedContributionCount(int durationSeconds) {
+    // A contribution is made at t=0, then after each delay while the race still runs
+    int count = 0;
+    int elapsed = 0;
+    int delay = FIRST_CONTRIBUTION_DELAY;
+    while (elapsed < durationSeconds) {
+        count++;
+        delay = NextContributionDelay(delay);
+        elapsed += delay;
+    }
+    return count;
+}
+
+int PickSimulatedHorse(RaceRng& rng, int numHorses) {
+    std::uniform_int_distribution<int> dis(0, numHorses - 1);
+    return dis(rng);
+}
+
+void SimulateRaceInstant(const RaceConfig& config, RaceRng& rng, std::vector<long long>& contributions) {
+    contributions.assign(config.numHorses, 0);
+    int count = SimulatedContributionCount(config.durationSeconds);
+    for (int i = 0; i < count; i++) {
+        contributions[PickSimulatedHorse(rng, config.numHorses)] += config.contributionAmount;
+    }
+}
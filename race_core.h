@@ -0,0 +1,165 @@
+#pragma once
+
+// Race and prize logic shared by the game and the headless tools.
+// Nothing in here depends on SDL.
+
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdint>
+
+// Game constants
+const int CONTRIBUTION_AMOUNT = 10000000; // 1000万円
+const long long PRIZE_CAP = 300000000;    // 3億円
+const std::vector<long long> PRIZE_DISTRIBUTION = {200000000, 100000000, 100000000, 0, 0, 0};
+const int PRIZE_PLACES = 3;
+const int FIRST_CONTRIBUTION_DELAY = 10;  // Seconds, shrinks by one after every simulated contribution
+const int DEFAULT_RACE_SECONDS = 100;     // Roughly the length of race_bgm.mp3
+
+// Random engine used for every simulated race
+using RaceRng = std::mt19937_64;
+
+struct RaceConfig {
+    int numHorses;
+    int durationSeconds;
+    long long contributionAmount;
+
+    RaceConfig() : numHorses(6), durationSeconds(DEFAULT_RACE_SECONDS), contributionAmount(CONTRIBUTION_AMOUNT) {}
+};
+
+// "1億2000万円" style formatting
+std::string FormatMoney(long long amount);
+
+// Same, written to buffer without allocating. Returns the length written;
+// MONEY_TEXT_MAX bytes always suffice, and a smaller buffer gets nothing.
+const size_t MONEY_TEXT_MAX = 48;
+size_t FormatMoney(long long amount, char* buffer, size_t size);
+
+// Horse indices ordered by contribution, highest first. Ties keep the lower index first.
+std::vector<size_t> RankHorses(const std::vector<long long>& contributions);
+
+// Fill top[0..count) with the best horses without sorting the whole field.
+// Returns how many entries were written (less than count for small fields).
+int TopHorses(const std::vector<long long>& contributions, size_t* top, int count);
+
+// Sum of the top PRIZE_PLACES contributions, capped at PRIZE_CAP
+long long CalculatePrize(const std::vector<long long>& contributions);
+
+// How the prize divides among the placed horses top[0..count): each gets its
+// contribution, scaled down like the prize when that is capped
+void PrizeShares(const std::vector<long long>& contributions, const size_t* top, int count, long long* shares);
+
+// Ranking of a contributions array kept up to date one change at a time.
+// Same order as RankHorses(). The array itself stays with the caller and is
+// passed in on every change.
+//
+// The horses form a treap ordered by (contribution, index) that counts the
+// horses under every node, so moving a horse and finding a place are both
+// O(log n) however many horses are tied. Each horse is its own node, so
+// nothing is allocated after Rebuild().
+class Leaderboard {
+public:
+    Leaderboard() : root(NO_HORSE) {}
+
+    // Rank every horse from scratch, O(n log n)
+    void Rebuild(const std::vector<long long>& contributions);
+
+    // contributions[horse] has changed; move it to its new place, O(log n)
+    void Update(const std::vector<long long>& contributions, size_t horse);
+
+    size_t Size() const { return keys.size(); }
+    size_t HorseAt(size_t place) const;     // 0 = leader, O(log n)
+    size_t PlaceOf(size_t horse) const;     // O(log n)
+
+    // Same results as TopHorses(), without looking at the rest of the field
+    int Top(size_t* top, int count) const;
+
+    // Same as CalculatePrize(contributions)
+    long long Prize(const std::vector<long long>& contributions) const;
+
+private:
+    static constexpr uint32_t NO_HORSE = UINT32_MAX;
+
+    // Whether horse a ranks ahead of horse b
+    bool Ahead(uint32_t a, uint32_t b) const { return keys[a] > keys[b] || (keys[a] == keys[b] && a < b); }
+    uint32_t Count(uint32_t node) const { return node == NO_HORSE ? 0 : counts[node]; }
+    void Recount(uint32_t node) { counts[node] = 1 + Count(left[node]) + Count(right[node]); }
+    // Split node into the horses ahead of horse and the rest
+    void Split(uint32_t node, uint32_t horse, uint32_t& ahead, uint32_t& behind);
+    uint32_t Merge(uint32_t ahead, uint32_t behind);
+    uint32_t Remove(uint32_t node, uint32_t horse);
+
+    std::vector<long long> keys;        // Contribution of each horse as ranked; the caller's array has already changed in Update()
+    std::vector<uint32_t> priorities;   // Heap order of the treap, fixed per horse
+    std::vector<uint32_t> left;         // Horses ahead
+    std::vector<uint32_t> right;        // Horses behind
+    std::vector<uint32_t> counts;       // Horses in each subtree
+    uint32_t root;
+};
+
+// Live pari-mutuel odds. Every contribution goes into one pool, and if a
+// horse wins its backers share the pool, so each yen on it returns
+// pool / its total. Only the pool is kept here; the per-horse totals stay
+// with the caller as for Leaderboard. A contribution costs one addition and
+// reading the odds of a horse one division, whatever the size of the field.
+class PoolOdds {
+public:
+    PoolOdds() : total(0) {}
+
+    // Sum the pool from scratch, O(n)
+    void Rebuild(const std::vector<long long>& contributions);
+    void Add(long long amount) { total += amount; }
+
+    long long Total() const { return total; }
+
+    // Return per yen on a horse with staked yen on it, stake included; 0 while nothing is on it
+    double Odds(long long staked) const { return staked > 0 ? (double)total / staked : 0.0; }
+
+private:
+    long long total;
+};
+
+// Delay before the next simulated contribution
+inline int NextContributionDelay(int delay) {
+    return delay > 1 ? delay - 1 : 1;
+}
+
+// Number of simulated contributions made during a race of the given length
+int SimulatedContributionCount(int durationSeconds);
+
+// Horse receiving the next simulated contribution
+int PickSimulatedHorse(RaceRng& rng, int numHorses);
+
+// Simulated contributions of one race as a function of race time. Everything
+// follows from the seed, so a race can be re-run exactly from it.
+class RaceSimulator {
+public:
+    RaceSimulator() : numHorses(1), delay(FIRST_CONTRIBUTION_DELAY), nextSeconds(0) {}
+
+    void Start(uint64_t seed, int numHorses) {
+        rng.seed(seed);
+        this->numHorses = numHorses;
+        delay = FIRST_CONTRIBUTION_DELAY;
+        nextSeconds = 0;
+    }
+
+    // Call contribute(horse) for every simulated contribution due by elapsedSeconds, in order
+    template <typename F>
+    void Advance(double elapsedSeconds, F&& contribute) {
+        while (nextSeconds <= elapsedSeconds) {
+            contribute(PickSimulatedHorse(rng, numHorses));
+            delay = NextContributionDelay(delay);
+            nextSeconds += delay;
+        }
+    }
+
+private:
+    RaceRng rng;
+    int numHorses;
+    int delay;
+    double nextSeconds;
+};
+
+// Run one race without any real-time waiting. contributions is resized to
+// config.numHorses, cleared, and receives every simulated contribution.
+void SimulateRaceInstant(const RaceConfig& config, RaceRng& rng, std::vector<long long>& contributions);
@@ -0,0 +1,225 @@
+#include "race_history.h"
+#include "race_core.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const size_t TARGET_BLOCK_BYTES = 4 << 20;  // Blocks hold as many races as fit in about this much
+const uint32_t MIN_BLOCK_RACES = 64;
+const uint32_t MAX_BLOCK_RACES = 4096;
+
+// Per race: time, seed and prize; per horse and race: contribution, payout and place
+static size_t RowBytes(uint32_t numHorses) {
+    return 3 * sizeof(int64_t) + numHorses * (2 * sizeof(int64_t) + sizeof(uint32_t));
+}
+
+static size_t BlocksFor(uint64_t races, uint32_t blockRaces) {
+    return (size_t)((races + blockRaces - 1) / blockRaces);
+}
+
+RaceHistory::RaceHistory() : fd(-1), writable(false), base(nullptr), mappedSize(0), header(nullptr) {}
+
+RaceHistory::~RaceHistory() {
+    Close();
+}
+
+bool RaceHistory::Open(const std::string& path, int numHorses) {
+    Close();
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to open race history " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size == 0) {
+        RaceHistoryHeader created;
+        memset(&created, 0, sizeof(created));
+        memcpy(created.magic, RACE_HISTORY_MAGIC, sizeof(created.magic));
+        created.version = RACE_HISTORY_VERSION;
+        created.numHorses = (uint32_t)numHorses;
+        uint32_t blockRaces = (uint32_t)(TARGET_BLOCK_BYTES / RowBytes(created.numHorses));
+        created.blockRaces = std::max(MIN_BLOCK_RACES, std::min(MAX_BLOCK_RACES, blockRaces / 64 * 64));
+        if (pwrite(fd, &created, sizeof(created), 0) != (ssize_t)sizeof(created)) {
+            std::cerr << "Failed to write race history " << path << ": " << strerror(errno) << std::endl;
+            Close();
+            return false;
+        }
+    }
+    if (fstat(fd, &info) != 0 || !Map((size_t)info.st_size, true)) {
+        std::cerr << "Failed to map race history " << path << ": " << strerror(errno) << std::endl;
+        Close();
+        return false;
+    }
+    if (header->numHorses != (uint32_t)numHorses) {
+        std::cerr << "Race history " << path << " is for " << header->numHorses << " horses, not " << numHorses << std::endl;
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool RaceHistory::OpenReadOnly(const std::string& path) {
+    Close();
+    fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        std::cerr << "Failed to open race history " << path << ": " << strerror(errno) << std::endl;
+        Close();
+        return false;
+    }
+    if (!Map((size_t)info.st_size, false)) {
+        std::cerr << "Failed to map race history " << path << ": " << strerror(errno) << std::endl;
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void RaceHistory::Close() {
+    Unmap();
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+// Map size bytes of the file and check that the header describes them
+bool RaceHistory::Map(size_t size, bool writable) {
+    Unmap();
+    if (size < sizeof(RaceHistoryHeader)) {
+        errno = EINVAL;
+        return false;
+    }
+    void* mapping = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) return false;
+    base = static_cast<char*>(mapping);
+    mappedSize = size;
+    this->writable = writable;
+    header = reinterpret_cast<RaceHistoryHeader*>(base);
+
+    bool valid = memcmp(header->magic, RACE_HISTORY_MAGIC, sizeof(header->magic)) == 0 &&
+                 header->version == RACE_HISTORY_VERSION && header->numHorses > 0 && header->blockRaces > 0 &&
+                 sizeof(RaceHistoryHeader) + BlocksFor(header->raceCount, header->blockRaces) * BlockBytes() <= size;
+    if (!valid) {
+        Unmap();
+        errno = EINVAL;
+        return false;
+    }
+    return true;
+}
+
+void RaceHistory::Unmap() {
+    if (base) munmap(base, mappedSize);
+    base = nullptr;
+    mappedSize = 0;
+    header = nullptr;
+}
+
+uint64_t RaceHistory::RaceCount() const {
+    if (!header) return 0;
+    uint64_t mappedRaces = (mappedSize - sizeof(RaceHistoryHeader)) / BlockBytes() * header->blockRaces;
+    return std::min(__atomic_load_n(&header->raceCount, __ATOMIC_ACQUIRE), mappedRaces);
+}
+
+size_t RaceHistory::BlockBytes() const {
+    return header->blockRaces * RowBytes(header->numHorses);
+}
+
+char* RaceHistory::Block(uint64_t block) const {
+    return base + sizeof(RaceHistoryHeader) + block * BlockBytes();
+}
+
+bool RaceHistory::Append(const RaceHistoryRow& row) {
+    if (!header || !writable) return false;
+
+    uint64_t race = header->raceCount;
+    uint32_t blockRaces = header->blockRaces;
+    size_t needed = sizeof(RaceHistoryHeader) + BlocksFor(race + 1, blockRaces) * BlockBytes();
+    if (needed > mappedSize) {
+        // The new block reads as zeros until written; no disk is used for it until then
+        if (ftruncate(fd, (off_t)needed) != 0 || !Map(needed, true)) {
+            std::cerr << "Failed to grow race history: " << strerror(errno) << std::endl;
+            return false;
+        }
+    }
+
+    *RaceColumn<int64_t>(race, 0) = row.timeMs;
+    *RaceColumn<uint64_t>(race, 1) = row.seed;
+    *RaceColumn<long long>(race, 2) = row.prize;
+
+    size_t numHorses = header->numHorses;
+    size_t index = race % blockRaces;
+    char* block = Block(race / blockRaces);
+    long long* contributions = reinterpret_cast<long long*>(block + 3 * blockRaces * sizeof(int64_t));
+    long long* payouts = contributions + numHorses * blockRaces;
+    uint32_t* finish = reinterpret_cast<uint32_t*>(payouts + numHorses * blockRaces);
+    for (size_t horse = 0; horse < numHorses; horse++) {
+        contributions[horse * blockRaces + index] = row.contributions[horse];
+        payouts[horse * blockRaces + index] = row.payouts ? row.payouts[horse] : 0;
+        finish[horse * blockRaces + index] = row.finish[horse];
+    }
+
+    // Publish the race only once its columns are in place
+    __atomic_store_n(&header->raceCount, race + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+HorseHistory RaceHistory::ScanHorse(int horse, uint64_t first, uint64_t last) const {
+    HorseHistory history;
+    if (!header || horse < 0 || horse >= (int)header->numHorses) return history;
+    last = std::min(last, RaceCount());
+    if (first >= last) return history;
+
+    size_t numHorses = header->numHorses;
+    uint32_t blockRaces = header->blockRaces;
+    uint64_t streak = 0;
+    for (uint64_t start = first; start < last;) {
+        uint64_t blockIndex = start / blockRaces;
+        size_t begin = (size_t)(start % blockRaces);
+        size_t end = (size_t)std::min<uint64_t>(blockRaces, last - blockIndex * blockRaces);
+
+        const char* block = Block(blockIndex);
+        const long long* contributions = reinterpret_cast<const long long*>(block + 3 * blockRaces * sizeof(int64_t));
+        const long long* payouts = contributions + numHorses * blockRaces;
+        const uint32_t* finish = reinterpret_cast<const uint32_t*>(payouts + numHorses * blockRaces);
+        contributions += horse * blockRaces;
+        payouts += horse * blockRaces;
+        finish += horse * blockRaces;
+
+        // One column per loop, each a straight sequential read
+        long long contributed = 0, paid = 0;
+        uint64_t wins = 0, placed = 0;
+        for (size_t i = begin; i < end; i++) contributed += contributions[i];
+        for (size_t i = begin; i < end; i++) paid += payouts[i];
+        for (size_t i = begin; i < end; i++) wins += finish[i] == 0;
+        for (size_t i = begin; i < end; i++) placed += finish[i] < (uint32_t)PRIZE_PLACES;
+        history.contributed += contributed;
+        history.paid += paid;
+        history.wins += wins;
+        history.placed += placed;
+
+        // Streaks carry over from block to block
+        for (size_t i = begin; i < end; i++) {
+            streak = finish[i] == 0 ? streak + 1 : 0;
+            history.longestStreak = std::max(history.longestStreak, streak);
+        }
+        if (wins == 0) {
+            history.racesSinceWin += end - begin;
+        } else {
+            size_t lastWin = end - 1;
+            while (finish[lastWin] != 0) lastWin--;
+            history.racesSinceWin = end - 1 - lastWin;
+        }
+        start = blockIndex * blockRaces + end;
+    }
+    history.races = last - first;
+    history.currentStreak = streak;
+    return history;
+}
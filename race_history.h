@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Every race result ever recorded, kept in one memory-mapped file for
+// historical queries. Nothing in here depends on SDL.
+//
+// File layout: a RaceHistoryHeader, then fixed-size blocks of blockRaces
+// races each. Inside a block every column is stored on its own: times,
+// seeds and prizes one value per race, then for each horse its
+// contributions, its payouts and its finishing places over the block's
+// races. A question about one horse therefore reads a few contiguous arrays
+// per block and nothing else, front to back.
+//
+// Appending writes the columns of the new race in place (the file grows one
+// block at a time) and then bumps raceCount in the header, so a reader never
+// sees a half-written race. Values are stored in the machine's byte order.
+
+const char RACE_HISTORY_MAGIC[4] = {'E', 'Q', 'R', 'H'};
+const uint32_t RACE_HISTORY_VERSION = 1;
+
+struct RaceHistoryHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t numHorses;
+    uint32_t blockRaces;        // Races per block
+    uint64_t raceCount;         // Races written so far
+    uint64_t reserved[5];
+};
+
+static_assert(sizeof(RaceHistoryHeader) == 64, "RaceHistoryHeader layout is part of the file format");
+
+// One finished race; every array has one entry per horse
+struct RaceHistoryRow {
+    int64_t timeMs;                 // Unix time the race finished, in milliseconds
+    uint64_t seed;                  // Seed the race was simulated from (0 if unknown)
+    long long prize;
+    const long long* contributions;
+    const long long* payouts;       // Paid to each horse's backers; null if nothing was paid
+    const uint32_t* finish;         // Finishing place, 0 = winner
+};
+
+// One horse over a range of races
+struct HorseHistory {
+    uint64_t races;
+    uint64_t wins;
+    uint64_t placed;                // Finished in the prize places (PRIZE_PLACES)
+    long long contributed;
+    long long paid;
+    uint64_t longestStreak;         // Most wins in a row
+    uint64_t currentStreak;         // Wins in a row up to the last race of the range
+    uint64_t racesSinceWin;         // The whole range if it never won
+
+    HorseHistory() : races(0), wins(0), placed(0), contributed(0), paid(0), longestStreak(0), currentStreak(0), racesSinceWin(0) {}
+
+    double WinRate() const { return races ? (double)wins / races : 0.0; }
+    double AverageContribution() const { return races ? (double)contributed / races : 0.0; }
+};
+
+class RaceHistory {
+public:
+    RaceHistory();
+    ~RaceHistory();
+
+    RaceHistory(const RaceHistory&) = delete;
+    RaceHistory& operator=(const RaceHistory&) = delete;
+
+    // Open path for appending, creating it for numHorses if it does not exist.
+    // Fails if it was created for a different field size.
+    bool Open(const std::string& path, int numHorses);
+    // Open path for queries only
+    bool OpenReadOnly(const std::string& path);
+    void Close();
+    bool IsOpen() const { return header != nullptr; }
+
+    int HorseCount() const { return header ? (int)header->numHorses : 0; }
+    // Races readable through this mapping; another process may have appended more since it was opened
+    uint64_t RaceCount() const;
+
+    // Returns false if the file could not grow
+    bool Append(const RaceHistoryRow& row);
+
+    int64_t TimeMs(uint64_t race) const { return *RaceColumn<int64_t>(race, 0); }
+    uint64_t Seed(uint64_t race) const { return *RaceColumn<uint64_t>(race, 1); }
+    long long Prize(uint64_t race) const { return *RaceColumn<long long>(race, 2); }
+
+    // Statistics of horse over races [first, last)
+    HorseHistory ScanHorse(int horse, uint64_t first, uint64_t last) const;
+    HorseHistory ScanHorse(int horse) const { return ScanHorse(horse, 0, RaceCount()); }
+
+private:
+    size_t BlockBytes() const;
+    char* Block(uint64_t block) const;
+    bool Map(size_t size, bool writable);
+    void Unmap();
+
+    // column: 0 = time, 1 = seed, 2 = prize
+    template <typename T>
+    T* RaceColumn(uint64_t race, int column) const {
+        uint64_t blockRaces = header->blockRaces;
+        char* block = Block(race / blockRaces);
+        return reinterpret_cast<T*>(block + (column * blockRaces + race % blockRaces) * 8);
+    }
+
+    int fd;
+    bool writable;
+    char* base;                     // Mapping of the whole file
+    size_t mappedSize;
+    RaceHistoryHeader* header;      // At base
+};
@@ -0,0 +1,241 @@
+// Load generator for race_server.
+// Opens many connections, keeps a fixed number of contributions in flight on
+// each, and reports sustained throughput and acknowledgement latency.
+//
+//   ./race_load [--port N] [--connections N] [--pipeline N] [--seconds N] [--horses N] [--start-race]
+
+#include "race_core.h"
+#include "race_protocol.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+typedef std::chrono::steady_clock Clock;
+
+struct LoadConnection {
+    int fd;
+    std::string input;
+    std::string output;                      // Commands not yet accepted by the socket
+    std::deque<Clock::time_point> inFlight;  // Send time of each contribution awaiting its OK/ERR
+    int untimedAcks;                         // Acks expected before those, for commands that are not timed
+
+    explicit LoadConnection(int fd) : fd(fd), untimedAcks(0) {}
+};
+
+struct LoadStats {
+    long long sent;
+    long long acked;
+    long long errors;
+    long long broadcasts;
+    std::vector<double> latencyUs;
+
+    LoadStats() : sent(0), acked(0), errors(0), broadcasts(0) {}
+};
+
+static int Connect(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons((unsigned short)port);
+    if (connect(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+// Write queued commands; returns false if the connection failed
+static bool FlushOutput(LoadConnection& connection) {
+    while (!connection.output.empty()) {
+        ssize_t sent = send(connection.fd, connection.output.data(), connection.output.size(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        connection.output.erase(0, sent);
+    }
+    return true;
+}
+
+// Read replies, timing each acknowledgement; returns false if the connection closed
+static bool ReadReplies(LoadConnection& connection, LoadStats& stats) {
+    char buffer[16384];
+    while (true) {
+        ssize_t received = recv(connection.fd, buffer, sizeof(buffer), 0);
+        if (received == 0) return false;
+        if (received < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        connection.input.append(buffer, received);
+
+        Clock::time_point now = Clock::now();
+        size_t start = 0;
+        size_t end;
+        while ((end = connection.input.find('\n', start)) != std::string::npos) {
+            const char* line = connection.input.c_str() + start;
+            bool ok = strncmp(line, "OK", 2) == 0;
+            if (ok || strncmp(line, "ERR", 3) == 0) {
+                if (!ok) stats.errors++;
+                if (connection.untimedAcks > 0) {
+                    connection.untimedAcks--;
+                } else if (!connection.inFlight.empty()) {
+                    stats.acked++;
+                    stats.latencyUs.push_back(std::chrono::duration<double, std::micro>(now - connection.inFlight.front()).count());
+                    connection.inFlight.pop_front();
+                }
+            } else {
+                stats.broadcasts++;
+            }
+            start = end + 1;
+        }
+        connection.input.erase(0, start);
+    }
+}
+
+static double Percentile(std::vector<double>& sorted, double percentile) {
+    if (sorted.empty()) return 0;
+    size_t rank = (size_t)(percentile / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[rank];
+}
+
+int main(int argc, char* argv[]) {
+    int port = DEFAULT_SERVER_PORT;
+    int connectionCount = 64;
+    int pipeline = 16;
+    double seconds = 10;
+    int numHorses = 6;
+    bool startRace = false;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--port") && hasValue) {
+            port = std::atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--connections") && hasValue) {
+            connectionCount = std::max(1, std::atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--pipeline") && hasValue) {
+            pipeline = std::max(1, std::atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--seconds") && hasValue) {
+            seconds = std::max(0.1, std::atof(argv[++i]));
+        } else if (!strcmp(argv[i], "--horses") && hasValue) {
+            numHorses = std::max(1, std::atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--start-race")) {
+            startRace = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--port N] [--connections N] [--pipeline N] [--seconds N] [--horses N] [--start-race]" << std::endl;
+            return 1;
+        }
+    }
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    std::vector<std::unique_ptr<LoadConnection>> connections;
+    for (int i = 0; i < connectionCount; i++) {
+        int fd = Connect(port);
+        if (fd < 0) {
+            std::cerr << "Failed to connect to 127.0.0.1:" << port << ": " << strerror(errno) << std::endl;
+            return 1;
+        }
+        connections.emplace_back(new LoadConnection(fd));
+        epoll_event event;
+        event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+        event.data.u32 = (uint32_t)i;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+    if (startRace) {
+        connections[0]->output += "S\n";
+        connections[0]->untimedAcks++;
+    }
+
+    std::cout << "Sending contributions on " << connectionCount << " connections, " << pipeline
+              << " in flight each, for " << seconds << "s" << std::endl;
+
+    LoadStats stats;
+    stats.latencyUs.reserve(1 << 20);
+    RaceRng rng(std::random_device{}());
+    std::vector<epoll_event> events(connectionCount);
+    Clock::time_point start = Clock::now();
+    Clock::time_point stopSending = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    Clock::time_point giveUp = stopSending + std::chrono::seconds(5); // For acks still in flight
+    bool sending = true;
+    long long outstanding = 0;
+
+    while (true) {
+        Clock::time_point now = Clock::now();
+        if (sending && now >= stopSending) sending = false;
+        if ((!sending && outstanding == 0) || now >= giveUp) break;
+
+        // Top every connection up to the pipeline depth
+        if (sending) {
+            char command[64];
+            for (auto& connection : connections) {
+                if (connection->fd < 0) continue;
+                while ((int)connection->inFlight.size() < pipeline) {
+                    int horse = PickSimulatedHorse(rng, numHorses) + 1;
+                    int length = snprintf(command, sizeof(command), "C %d\n", horse);
+                    connection->output.append(command, length);
+                    connection->inFlight.push_back(Clock::now());
+                    stats.sent++;
+                }
+                if (!FlushOutput(*connection)) {
+                    std::cerr << "Connection lost" << std::endl;
+                    close(connection->fd);
+                    connection->fd = -1;
+                }
+            }
+        }
+
+        int count = epoll_wait(epollFd, events.data(), (int)events.size(), 100);
+        for (int i = 0; i < count; i++) {
+            LoadConnection& connection = *connections[events[i].data.u32];
+            if (connection.fd < 0) continue;
+            bool open = ReadReplies(connection, stats) && FlushOutput(connection);
+            if (!open) {
+                std::cerr << "Connection closed by server" << std::endl;
+                close(connection.fd);
+                connection.fd = -1;
+                connection.inFlight.clear();
+            }
+        }
+
+        outstanding = 0;
+        for (const auto& connection : connections) outstanding += connection->inFlight.size();
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    for (auto& connection : connections) {
+        if (connection->fd >= 0) close(connection->fd);
+    }
+    close(epollFd);
+
+    std::sort(stats.latencyUs.begin(), stats.latencyUs.end());
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "\nSent:       " << stats.sent << std::endl;
+    std::cout << "Acked:      " << stats.acked << " (" << stats.errors << " errors)" << std::endl;
+    std::cout << "Broadcasts: " << stats.broadcasts << std::endl;
+    std::cout << "Throughput: " << stats.acked / elapsed << " contributions/s" << std::endl;
+    std::cout << "Ack latency (us): p50 " << Percentile(stats.latencyUs, 50) << ", p95 " << Percentile(stats.latencyUs, 95)
+              << ", p99 " << Percentile(stats.latencyUs, 99)
+              << ", max " << (stats.latencyUs.empty() ? 0 : stats.latencyUs.back()) << std::endl;
+    return 0;
+}
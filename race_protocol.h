@@ -0,0 +1,27 @@
+#pragma once
+
+// Line protocol between race_server and its clients. Every message is one
+// line of ASCII ending in '\n'; horse numbers are 1-based as in the game.
+//
+//   client -> server
+//     C <horse> [amount]   contribute (amount defaults to CONTRIBUTION_AMOUNT)
+//     S                    start a race
+//     Q                    send the standings now
+//
+//   server -> client
+//     OK | ERR <reason>    exactly one per command, in the order received
+//     STANDINGS <racing> <seconds> <total> <horse>:<amount>...
+//                          leaders, broadcast to everyone when they change;
+//                          a horse's live odds are <total> / <amount>
+//     RESULT <prize> <horse>:<amount>...
+//                          winners, broadcast when a race ends
+//     PAYOUT <amount>      what this client's bets won, sent after RESULT to
+//                          every client that contributed during the race
+//
+// Clients can pipeline commands; acknowledgements come back in order, but
+// broadcasts may arrive between them.
+
+#include <cstddef>
+
+const int DEFAULT_SERVER_PORT = 7650;
+const size_t MAX_LINE_LENGTH = 256;   // Longer commands close the connection
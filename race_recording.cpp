@@ -0,0 +1,129 @@
+#include "race_recording.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+bool WriteRaceRecording(const std::string& path, const RaceRecording& recording) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        std::cerr << "Failed to write race recording " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    fprintf(file, "equis-race %d\n", RACE_RECORDING_VERSION);
+    fprintf(file, "horses %d\n", recording.numHorses);
+    fprintf(file, "seed %llu\n", (unsigned long long)recording.seed);
+    fprintf(file, "tick %.17g\n", recording.tickSeconds); // Round-trips exactly
+    fputs("initial", file);
+    for (long long amount : recording.initial) fprintf(file, " %lld", amount);
+    fputc('\n', file);
+    for (const RecordedContribution& c : recording.contributions) {
+        fprintf(file, "c %lld %d %lld\n", c.tick, c.horse + 1, c.amount);
+    }
+    fprintf(file, "end %lld\n", recording.endTick);
+    fprintf(file, "result %lld %llu\n", recording.prize, (unsigned long long)recording.totalsHash);
+
+    bool ok = !ferror(file);
+    if (fclose(file) != 0) ok = false;
+    if (!ok) std::cerr << "Failed to write race recording " << path << std::endl;
+    return ok;
+}
+
+bool ReadRaceRecording(const std::string& path, RaceRecording& recording) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Failed to open race recording " << path << std::endl;
+        return false;
+    }
+
+    recording = RaceRecording();
+    bool ended = false, hasResult = false;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        std::istringstream fields(line);
+        std::string key;
+        fields >> key;
+        bool ok = true;
+        if (key.empty()) {
+            continue;
+        } else if (key == "equis-race") {
+            int version = 0;
+            ok = (fields >> version) && version == RACE_RECORDING_VERSION;
+        } else if (key == "horses") {
+            ok = (fields >> recording.numHorses) && recording.numHorses > 0;
+        } else if (key == "seed") {
+            unsigned long long seed;
+            ok = (bool)(fields >> seed);
+            recording.seed = seed;
+        } else if (key == "tick") {
+            ok = (fields >> recording.tickSeconds) && recording.tickSeconds > 0;
+        } else if (key == "initial") {
+            long long amount;
+            while (fields >> amount) recording.initial.push_back(amount);
+            ok = (int)recording.initial.size() == recording.numHorses;
+        } else if (key == "c") {
+            RecordedContribution c;
+            ok = (fields >> c.tick >> c.horse >> c.amount) && c.horse >= 1 && c.horse <= recording.numHorses;
+            c.horse--;
+            recording.contributions.push_back(c);
+        } else if (key == "end") {
+            ok = (bool)(fields >> recording.endTick);
+            ended = true;
+        } else if (key == "result") {
+            unsigned long long hash;
+            ok = (bool)(fields >> recording.prize >> hash);
+            recording.totalsHash = hash;
+            hasResult = true;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            std::cerr << path << ":" << lineNumber << ": malformed line: " << line << std::endl;
+            return false;
+        }
+    }
+    if (recording.numHorses <= 0 || (int)recording.initial.size() != recording.numHorses || !ended || !hasResult) {
+        std::cerr << path << ": incomplete race recording" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+uint64_t HashTotals(const std::vector<long long>& totals) {
+    uint64_t hash = 14695981039346656037ull;
+    for (long long amount : totals) {
+        uint64_t value = (uint64_t)amount;
+        for (int byte = 0; byte < 8; byte++) {
+            hash ^= (value >> (byte * 8)) & 0xFF;
+            hash *= 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+void ReplayRace(const RaceRecording& recording, std::vector<long long>& totals,
+                const std::function<void(long long tick, const std::vector<long long>& totals)>& onTick) {
+    totals = recording.initial;
+    RaceSimulator simulator;
+    simulator.Start(recording.seed, recording.numHorses);
+
+    double elapsed = 0;
+    size_t next = 0;
+    for (long long tick = 0; ; tick++) {
+        while (next < recording.contributions.size() && recording.contributions[next].tick <= tick) {
+            const RecordedContribution& c = recording.contributions[next++];
+            totals[c.horse] += c.amount;
+        }
+        if (tick >= recording.endTick) break;
+
+        elapsed += recording.tickSeconds;
+        simulator.Advance(elapsed, [&totals](int horse) {
+            totals[horse] += CONTRIBUTION_AMOUNT;
+        });
+        if (onTick) onTick(tick + 1, totals);
+    }
+}
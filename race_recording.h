@@ -0,0 +1,61 @@
+#pragma once
+
+// Race recordings: enough to re-run a race exactly and check its result.
+// Nothing in here depends on SDL.
+//
+// A race is a function of its seed (simulated contributions, see
+// RaceSimulator), the totals it started from and the outside contributions
+// applied during it, each tagged with the simulation tick it was applied on.
+// The recorded prize and a hash of the final totals let a re-run confirm it
+// reached the same outcome.
+//
+// Files are plain text so that a disputed race can be read by eye:
+//
+//   equis-race 1
+//   horses <n>
+//   seed <seed>
+//   tick <seconds per tick>
+//   initial <amount> x n
+//   c <tick> <horse> <amount>      one per outside contribution, horse 1-based
+//   end <tick>
+//   result <prize> <totals hash>
+
+#include "race_core.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+const int RACE_RECORDING_VERSION = 1;
+
+struct RecordedContribution {
+    long long tick;
+    int horse;
+    long long amount;
+};
+
+struct RaceRecording {
+    int numHorses;
+    uint64_t seed;
+    double tickSeconds;
+    std::vector<long long> initial;                    // Totals when the race started
+    std::vector<RecordedContribution> contributions;   // In the order they were applied
+    long long endTick;
+    long long prize;
+    uint64_t totalsHash;
+
+    RaceRecording() : numHorses(0), seed(0), tickSeconds(0), endTick(0), prize(0), totalsHash(0) {}
+};
+
+bool WriteRaceRecording(const std::string& path, const RaceRecording& recording);
+bool ReadRaceRecording(const std::string& path, RaceRecording& recording);
+
+// FNV-1a over the totals, for comparing outcomes without storing them all
+uint64_t HashTotals(const std::vector<long long>& totals);
+
+// Re-run the race into totals, in the same order as HorseRacingGame::Update():
+// on every tick the outside contributions recorded for it are applied first,
+// then the race clock advances and the simulated ones come due. onTick, if
+// set, runs after each tick, e.g. to pace playback in real time.
+void ReplayRace(const RaceRecording& recording, std::vector<long long>& totals,
+                const std::function<void(long long tick, const std::vector<long long>& totals)>& onTick = nullptr);
@@ -0,0 +1,94 @@
+// Re-runs recorded races (equis --record DIR) and checks each one reaches the
+// recorded result. By default races run unthrottled, back to back; with
+// --realtime each tick takes as long as it did in the game and the standings
+// are printed once a second.
+//
+//   ./race_replay [--realtime] FILE...
+
+#include "race_core.h"
+#include "race_recording.h"
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static void PrintStandings(long long tick, double tickSeconds, const std::vector<long long>& totals) {
+    Leaderboard standings;
+    standings.Rebuild(totals);
+    std::cout << std::fixed << std::setprecision(1) << std::setw(7) << tick * tickSeconds << "s " << std::defaultfloat;
+    for (size_t i = 0; i < standings.Size() && i < (size_t)PRIZE_PLACES; i++) {
+        size_t horse = standings.HorseAt(i);
+        std::cout << " " << horse + 1 << ":" << FormatMoney(totals[horse]);
+    }
+    std::cout << std::endl;
+}
+
+// Replay one recording; returns false if it could not be read or its result differs
+static bool ReplayFile(const std::string& path, bool realtime, long long& ticks) {
+    RaceRecording recording;
+    if (!ReadRaceRecording(path, recording)) return false;
+
+    std::vector<long long> totals;
+    if (realtime) {
+        std::cout << path << ": " << recording.numHorses << " horses, seed " << recording.seed << std::endl;
+        long long ticksPerSecond = std::max(1LL, (long long)(1.0 / recording.tickSeconds + 0.5));
+        Clock::time_point start = Clock::now();
+        ReplayRace(recording, totals, [&](long long tick, const std::vector<long long>& current) {
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(tick * recording.tickSeconds)));
+            if (tick % ticksPerSecond == 0) PrintStandings(tick, recording.tickSeconds, current);
+        });
+    } else {
+        ReplayRace(recording, totals);
+    }
+    ticks += recording.endTick;
+
+    Leaderboard results;
+    results.Rebuild(totals);
+    long long prize = results.Prize(totals);
+    bool match = prize == recording.prize && HashTotals(totals) == recording.totalsHash;
+    std::cout << (match ? "OK       " : "MISMATCH ") << path << "  prize " << FormatMoney(prize);
+    if (prize != recording.prize) std::cout << " (" << prize << " yen, recorded " << recording.prize << ")";
+    std::cout << std::endl;
+    return match;
+}
+
+int main(int argc, char* argv[]) {
+    bool realtime = false;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--realtime")) {
+            realtime = true;
+        } else if (argv[i][0] == '-') {
+            files.clear();
+            break;
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--realtime] FILE..." << std::endl;
+        return 1;
+    }
+
+    int failed = 0;
+    long long ticks = 0;
+    Clock::time_point start = Clock::now();
+    for (const std::string& file : files) {
+        if (!ReplayFile(file, realtime, ticks)) failed++;
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::cout << "\n" << files.size() - failed << "/" << files.size() << " races reproduced";
+    if (!realtime && seconds > 0) {
+        std::cout << " in " << std::fixed << std::setprecision(3) << seconds << " s ("
+                  << std::setprecision(0) << files.size() / seconds << " races/s, " << ticks / seconds << " ticks/s)";
+    }
+    std::cout << std::endl;
+    return failed == 0 ? 0 : 2;
+}
@@ -0,0 +1,521 @@
+// Race server: the game's race logic without a window, driven over TCP.
+// Any number of clients on localhost contribute and start races with the
+// line protocol in race_protocol.h; standings are broadcast to all of them.
+// Everything runs on one thread around epoll, so the race state needs no locks.
+//
+//   ./race_server [--port N] [--horses N] [--race-seconds N] [--time-scale X]
+//                 [--journal FILE [--journal-sync none|batch] [--journal-interval-ms N]]
+//                 [--place-prizes A,B,...] [--prize-cap N] [--pool-shares A,B,...] [--takeout X]
+//                 [--history FILE]
+//
+// Every connection is one bettor. Its contributions add up to one stake per
+// horse it backed, settled with the payout rules when the race ends.
+
+#include "game_clock.h"
+#include "journal.h"
+#include "payout.h"
+#include "race_core.h"
+#include "race_history.h"
+#include "race_protocol.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+const int TICK_MS = 100;                     // Race clock, simulated contributions and broadcasts
+const size_t MAX_PENDING_OUTPUT = 1 << 20;   // Clients further behind than this are dropped
+const int MAX_EVENTS = 256;
+
+static volatile std::sig_atomic_t stopRequested = 0;
+
+static void OnSignal(int) {
+    stopRequested = 1;
+}
+
+struct Connection {
+    int fd;
+    BetSlot bets;         // This client's stakes in the current race
+    std::string input;    // Bytes received after the last complete line
+    std::string output;   // Replies and broadcasts not yet accepted by the socket
+    size_t outputSent;    // Prefix of output already written
+    bool wantsWrite;      // EPOLLOUT registered
+
+    explicit Connection(int fd) : fd(fd), outputSent(0), wantsWrite(false) {}
+};
+
+class RaceServer {
+public:
+    RaceServer(int numHorses, double raceSeconds, double timeScale, const PayoutRules& rules) :
+        contributions(numHorses, 0),
+        previousResults(numHorses, 0),
+        bets(numHorses),
+        rules(rules),
+        raceSeconds(raceSeconds),
+        isRacing(false),
+        standingsChanged(true),
+        clock(GameClock::Scaled(timeScale)),
+        raceStart(0),
+        raceSeed(0),
+        epollFd(-1),
+        listenFd(-1),
+        timerFd(-1),
+        commandCount(0),
+        commandsAtLastReport(0) {
+        standings.Rebuild(contributions);
+    }
+
+    ~RaceServer() {
+        for (auto& entry : connections) close(entry.first);
+        if (timerFd >= 0) close(timerFd);
+        if (listenFd >= 0) close(listenFd);
+        if (epollFd >= 0) close(epollFd);
+    }
+
+    // Restore the totals and last result from path and log every change to it
+    bool OpenJournal(const std::string& path, JournalSync sync, int commitIntervalMs) {
+        int numHorses = (int)contributions.size();
+        bool opened = journal.Open(path, numHorses, sync, commitIntervalMs, [&](const JournalRecord& record) {
+            if (record.type == JOURNAL_CONTRIBUTION) {
+                if (record.horse >= 0 && record.horse < numHorses) contributions[record.horse] += record.amount;
+            } else if (record.type == JOURNAL_RACE_RESULT) {
+                previousResults = contributions;
+            }
+        });
+        if (!opened) return false;
+        standings.Rebuild(contributions);
+        results.Rebuild(previousResults);
+        odds.Rebuild(contributions);
+        std::cout << "Replayed " << journal.ReplayedRecords() << " journal records from " << path << std::endl;
+        return true;
+    }
+
+    // Append every race result to path
+    bool OpenHistory(const std::string& path) {
+        if (!history.Open(path, (int)contributions.size())) return false;
+        std::cout << "Recording results to " << path << " (" << history.RaceCount() << " races so far)" << std::endl;
+        return true;
+    }
+
+    bool Listen(int port) {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (epollFd < 0 || listenFd < 0 || timerFd < 0) {
+            std::cerr << "Failed to create server descriptors: " << strerror(errno) << std::endl;
+            return false;
+        }
+
+        int yes = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons((unsigned short)port);
+        if (bind(listenFd, (sockaddr*)&address, sizeof(address)) != 0 || listen(listenFd, SOMAXCONN) != 0) {
+            std::cerr << "Failed to listen on 127.0.0.1:" << port << ": " << strerror(errno) << std::endl;
+            return false;
+        }
+
+        itimerspec tick;
+        tick.it_interval.tv_sec = 0;
+        tick.it_interval.tv_nsec = TICK_MS * 1000000L;
+        tick.it_value = tick.it_interval;
+        timerfd_settime(timerFd, 0, &tick, nullptr);
+
+        epoll_event event;
+        event.events = EPOLLIN;
+        event.data.fd = listenFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+        event.data.fd = timerFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &event);
+
+        std::cout << "Listening on 127.0.0.1:" << port << " (" << contributions.size() << " horses, "
+                  << raceSeconds << "s races)" << std::endl;
+        return true;
+    }
+
+    void Run() {
+        epoll_event events[MAX_EVENTS];
+        lastReport = std::chrono::steady_clock::now();
+        while (!stopRequested) {
+            int count = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+            if (count < 0) {
+                if (errno == EINTR) continue;
+                std::cerr << "epoll_wait failed: " << strerror(errno) << std::endl;
+                break;
+            }
+            for (int i = 0; i < count; i++) {
+                int fd = events[i].data.fd;
+                if (fd == listenFd) {
+                    AcceptClients();
+                } else if (fd == timerFd) {
+                    uint64_t expirations;
+                    if (read(timerFd, &expirations, sizeof(expirations)) > 0) Tick();
+                } else {
+                    auto it = connections.find(fd);
+                    if (it == connections.end()) continue;
+                    Connection& connection = *it->second;
+                    bool open = true;
+                    if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) open = ReadCommands(connection);
+                    if (open) open = Flush(connection);
+                    if (!open) CloseConnection(fd);
+                }
+            }
+        }
+        std::cout << "Shutting down (" << connections.size() << " clients connected)" << std::endl;
+    }
+
+private:
+    void AcceptClients() {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    std::cerr << "accept failed: " << strerror(errno) << std::endl;
+                }
+                return;
+            }
+            int yes = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+            epoll_event event;
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+                close(fd);
+                continue;
+            }
+            std::unique_ptr<Connection> connection(new Connection(fd));
+            AppendStandings(connection->output); // New clients start from the current state
+            Flush(*connection);
+            connections[fd] = std::move(connection);
+        }
+    }
+
+    void CloseConnection(int fd) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        connections.erase(fd);
+    }
+
+    // Read what is available and run each complete line. Returns false when the connection should close.
+    bool ReadCommands(Connection& connection) {
+        char buffer[16384];
+        for (int reads = 0; reads < 4; reads++) { // Bounded so one busy client cannot starve the rest
+            ssize_t received = recv(connection.fd, buffer, sizeof(buffer), 0);
+            if (received == 0) return false;
+            if (received < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                if (errno == EINTR) continue;
+                return false;
+            }
+            connection.input.append(buffer, received);
+
+            size_t start = 0;
+            size_t end;
+            while ((end = connection.input.find('\n', start)) != std::string::npos) {
+                RunCommand(connection, connection.input.c_str() + start, end - start);
+                start = end + 1;
+            }
+            connection.input.erase(0, start);
+            if (connection.input.size() > MAX_LINE_LENGTH) return false;
+        }
+        return true;
+    }
+
+    void RunCommand(Connection& connection, const char* line, size_t length) {
+        commandCount++;
+        std::string text(line, length);
+        if (!text.empty() && text.back() == '\r') text.pop_back();
+
+        char command = text.empty() ? ' ' : text[0];
+        if (command == 'C') {
+            int horse = 0;
+            long long amount = CONTRIBUTION_AMOUNT;
+            int fields = sscanf(text.c_str() + 1, "%d %lld", &horse, &amount);
+            if (fields < 1 || horse < 1 || horse > (int)contributions.size() || amount <= 0) {
+                connection.output += "ERR bad contribution\n";
+                return;
+            }
+            AddContribution(connection.bets, horse - 1, amount);
+            connection.output += "OK\n";
+        } else if (command == 'S') {
+            if (isRacing) {
+                connection.output += "ERR racing\n";
+                return;
+            }
+            StartRace();
+            connection.output += "OK\n";
+        } else if (command == 'Q') {
+            connection.output += "OK\n";
+            AppendStandings(connection.output);
+        } else {
+            connection.output += "ERR unknown command\n";
+        }
+    }
+
+    // Write as much queued output as the socket takes. Returns false when the connection should close.
+    bool Flush(Connection& connection) {
+        while (connection.outputSent < connection.output.size()) {
+            ssize_t sent = send(connection.fd, connection.output.data() + connection.outputSent,
+                                connection.output.size() - connection.outputSent, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR) continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+                break;
+            }
+            connection.outputSent += sent;
+        }
+        if (connection.outputSent == connection.output.size()) {
+            connection.output.clear();
+            connection.outputSent = 0;
+        } else if (connection.output.size() - connection.outputSent > MAX_PENDING_OUTPUT) {
+            std::cerr << "Dropping a client that stopped reading" << std::endl;
+            return false;
+        }
+
+        // Only ask for EPOLLOUT while something is waiting to go out
+        bool wantsWrite = !connection.output.empty();
+        if (wantsWrite != connection.wantsWrite) {
+            epoll_event event;
+            event.events = EPOLLIN | (wantsWrite ? (uint32_t)EPOLLOUT : 0u);
+            event.data.fd = connection.fd;
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+            connection.wantsWrite = wantsWrite;
+        }
+        return true;
+    }
+
+    void Broadcast(const std::string& message) {
+        std::vector<int> dropped;
+        for (auto& entry : connections) {
+            entry.second->output += message;
+            if (!Flush(*entry.second)) dropped.push_back(entry.first);
+        }
+        for (int fd : dropped) CloseConnection(fd);
+    }
+
+    void AddContribution(BetSlot& bettor, int horse, long long amount) {
+        bets.Add(bettor, horse, amount);
+        contributions[horse] += amount;
+        standings.Update(contributions, horse);
+        odds.Add(amount);
+        standingsChanged = true;
+        if (journal.IsOpen()) journal.Append(JOURNAL_CONTRIBUTION, horse, amount);
+    }
+
+    void StartRace() {
+        isRacing = true;
+        raceStart = clock.Now();
+        raceSeed = ((uint64_t)std::random_device{}() << 32) ^ std::random_device{}();
+        simulator.Start(raceSeed, (int)contributions.size());
+        standingsChanged = true;
+        std::cout << "Race started, seed " << raceSeed << std::endl;
+    }
+
+    void StopRace() {
+        isRacing = false;
+        previousResults = contributions;
+        results = standings;
+        if (journal.IsOpen()) journal.Checkpoint(contributions, previousResults);
+
+        std::string message = "RESULT " + std::to_string(results.Prize(previousResults));
+        for (size_t i = 0; i < results.Size() && i < (size_t)PRIZE_PLACES; i++) {
+            size_t horse = results.HorseAt(i);
+            message += " " + std::to_string(horse + 1) + ":" + std::to_string(previousResults[horse]);
+        }
+        message += "\n";
+        Broadcast(message);
+        standingsChanged = true;
+        std::cout << "Race finished, prize " << FormatMoney(results.Prize(previousResults)) << std::endl;
+        SettleBets();
+    }
+
+    // Pay out the bets made since the last race and tell every bettor still
+    // connected what they won
+    void SettleBets() {
+        size_t places[PRIZE_PLACES];
+        int placeCount = results.Top(places, PRIZE_PLACES);
+        auto start = std::chrono::steady_clock::now();
+        SettleRace(bets, places, placeCount, rules, settlement);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Settled " << bets.Size() << " stakes of " << bets.BettorCount() << " bettors in " << ms << " ms: paid " << FormatMoney(settlement.paid)
+                  << ", unclaimed " << FormatMoney(settlement.unclaimed) << std::endl;
+
+        std::vector<int> dropped;
+        for (auto& entry : connections) {
+            Connection& connection = *entry.second;
+            if (!bets.HasBets(connection.bets)) continue;
+            connection.output += "PAYOUT " + std::to_string(settlement.bettorPayouts[connection.bets.bettor]) + "\n";
+            if (!Flush(connection)) dropped.push_back(entry.first);
+        }
+        for (int fd : dropped) CloseConnection(fd);
+        bets.Reset((int)contributions.size());
+        if (history.IsOpen()) AppendHistory();
+    }
+
+    // Add the race that just ended to the history file
+    void AppendHistory() {
+        finish.resize(contributions.size());
+        for (size_t horse = 0; horse < finish.size(); horse++) finish[horse] = (uint32_t)results.PlaceOf(horse);
+        RaceHistoryRow row;
+        row.timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        row.seed = raceSeed;
+        row.prize = results.Prize(previousResults);
+        row.contributions = previousResults.data();
+        row.payouts = settlement.awards.data();
+        row.finish = finish.data();
+        history.Append(row);
+    }
+
+    // Runs every TICK_MS: race clock, simulated contributions, then one broadcast if anything changed
+    void Tick() {
+        auto now = std::chrono::steady_clock::now();
+        clock.Advance(1.0); // A stalled tick still counts, up to a second
+        if (isRacing) {
+            double elapsed = clock.Now() - raceStart;
+            simulator.Advance(elapsed, [this](int horse) {
+                AddContribution(simulatedBets, horse, CONTRIBUTION_AMOUNT);
+            });
+            if (elapsed >= raceSeconds) StopRace();
+        }
+
+        if (standingsChanged) {
+            std::string message;
+            AppendStandings(message);
+            Broadcast(message);
+            standingsChanged = false;
+        }
+
+        double sinceReport = std::chrono::duration<double>(now - lastReport).count();
+        if (sinceReport >= 1.0) {
+            long long commands = commandCount - commandsAtLastReport;
+            if (commands > 0) {
+                std::cout << connections.size() << " clients, " << (long long)(commands / sinceReport) << " commands/s" << std::endl;
+            }
+            commandsAtLastReport = commandCount;
+            lastReport = now;
+        }
+    }
+
+    void AppendStandings(std::string& out) const {
+        long long total = odds.Total();
+        double seconds = isRacing ? clock.Now() - raceStart : 0;
+
+        char header[96];
+        snprintf(header, sizeof(header), "STANDINGS %d %.1f %lld", isRacing ? 1 : 0, seconds, total);
+        out += header;
+        for (size_t i = 0; i < standings.Size() && i < (size_t)PRIZE_PLACES; i++) {
+            size_t horse = standings.HorseAt(i);
+            out += " " + std::to_string(horse + 1) + ":" + std::to_string(contributions[horse]);
+        }
+        out += "\n";
+    }
+
+    std::vector<long long> contributions;
+    std::vector<long long> previousResults;
+    Leaderboard standings;
+    Leaderboard results;
+    PoolOdds odds;           // Pool total for the standings, kept up to date with every contribution
+    BetBook bets;            // Since the last race ended
+    PayoutRules rules;
+    Settlement settlement;
+    BetSlot simulatedBets;   // The race simulation bets like one more client
+    RaceHistory history;
+    std::vector<uint32_t> finish;   // Place of every horse in the last race, for the history
+    Journal journal;
+    double raceSeconds;
+    bool isRacing;
+    bool standingsChanged;   // Since the last broadcast
+    GameClock clock;         // Race time; runs faster than the wall clock with --time-scale
+    double raceStart;        // clock.Now() when the race started
+    uint64_t raceSeed;
+
+    RaceSimulator simulator;
+
+    int epollFd, listenFd, timerFd;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+
+    long long commandCount;
+    long long commandsAtLastReport;
+    std::chrono::steady_clock::time_point lastReport;
+};
+
+int main(int argc, char* argv[]) {
+    int port = DEFAULT_SERVER_PORT;
+    int numHorses = 6;
+    double raceSeconds = DEFAULT_RACE_SECONDS;
+    double timeScale = 1.0;
+    std::string journalPath;
+    JournalSync journalSync = JOURNAL_SYNC_BATCH;
+    int journalIntervalMs = DEFAULT_JOURNAL_INTERVAL_MS;
+    PayoutRules rules;
+    std::string historyPath;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--port") && hasValue) {
+            port = std::atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--horses") && hasValue) {
+            numHorses = std::max(1, std::atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--race-seconds") && hasValue) {
+            raceSeconds = std::max(1.0, std::atof(argv[++i]));
+        } else if (!strcmp(argv[i], "--time-scale") && hasValue) {
+            timeScale = std::max(0.001, std::atof(argv[++i]));
+        } else if (!strcmp(argv[i], "--journal") && hasValue) {
+            journalPath = argv[++i];
+        } else if (!strcmp(argv[i], "--journal-sync") && hasValue) {
+            journalSync = !strcmp(argv[++i], "none") ? JOURNAL_SYNC_NONE : JOURNAL_SYNC_BATCH;
+        } else if (!strcmp(argv[i], "--journal-interval-ms") && hasValue) {
+            journalIntervalMs = std::max(1, std::atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--place-prizes") && hasValue) {
+            rules.placePrizes.clear();
+            std::stringstream list(argv[++i]);
+            std::string item;
+            while (std::getline(list, item, ',')) rules.placePrizes.push_back(std::max(0LL, std::atoll(item.c_str())));
+        } else if (!strcmp(argv[i], "--prize-cap") && hasValue) {
+            rules.prizeCap = std::max(0LL, std::atoll(argv[++i]));
+        } else if (!strcmp(argv[i], "--pool-shares") && hasValue) {
+            rules.poolShares.clear();
+            std::stringstream list(argv[++i]);
+            std::string item;
+            while (std::getline(list, item, ',')) rules.poolShares.push_back(std::max(0.0, std::atof(item.c_str())));
+        } else if (!strcmp(argv[i], "--takeout") && hasValue) {
+            rules.takeout = std::max(0.0, std::min(1.0, std::atof(argv[++i])));
+        } else if (!strcmp(argv[i], "--history") && hasValue) {
+            historyPath = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--port N] [--horses N] [--race-seconds N] [--time-scale X]"
+                      << " [--journal FILE [--journal-sync none|batch] [--journal-interval-ms N]]"
+                      << " [--place-prizes A,B,...] [--prize-cap N] [--pool-shares A,B,...] [--takeout X]"
+                      << " [--history FILE]" << std::endl;
+            return 1;
+        }
+    }
+
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+
+    RaceServer server(numHorses, raceSeconds, timeScale, rules);
+    if (!journalPath.empty() && !server.OpenJournal(journalPath, journalSync, journalIntervalMs)) return 1;
+    if (!historyPath.empty() && !server.OpenHistory(historyPath)) return 1;
+    if (!server.Listen(port)) return 1;
+    server.Run();
+    return 0;
+}
@@ -0,0 +1,100 @@
+// Historical queries over a race history file written with --history by
+// the game, race_server or race_batch: per-horse win rates, contributions,
+// payouts and winning streaks.
+//
+//   ./race_stats FILE [--horse N] [--last N] [--top N]
+
+#include "race_core.h"
+#include "race_history.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+const int LIST_ALL_MAX = 20;    // Larger fields list only their best horses
+
+static std::string FormatTime(int64_t timeMs) {
+    time_t seconds = (time_t)(timeMs / 1000);
+    char text[32];
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", localtime(&seconds));
+    return text;
+}
+
+int main(int argc, char* argv[]) {
+    std::string path;
+    int onlyHorse = 0;          // 1-based; 0 = every horse
+    uint64_t last = 0;          // 0 = every race
+    int top = 10;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--horse") && hasValue) {
+            onlyHorse = std::max(1, std::atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--last") && hasValue) {
+            last = std::strtoull(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--top") && hasValue) {
+            top = std::max(1, std::atoi(argv[++i]));
+        } else if (argv[i][0] != '-' && path.empty()) {
+            path = argv[i];
+        } else {
+            path.clear();
+            break;
+        }
+    }
+    if (path.empty()) {
+        std::cerr << "Usage: " << argv[0] << " FILE [--horse N] [--last N] [--top N]" << std::endl;
+        return 1;
+    }
+
+    RaceHistory history;
+    if (!history.OpenReadOnly(path)) return 1;
+    uint64_t races = history.RaceCount();
+    int numHorses = history.HorseCount();
+    if (onlyHorse > numHorses) {
+        std::cerr << path << " has " << numHorses << " horses" << std::endl;
+        return 1;
+    }
+    if (races == 0) {
+        std::cout << "No races in " << path << std::endl;
+        return 0;
+    }
+    uint64_t first = last > 0 && last < races ? races - last : 0;
+
+    std::vector<int> horses;
+    if (onlyHorse > 0) {
+        horses.push_back(onlyHorse - 1);
+    } else {
+        for (int horse = 0; horse < numHorses; horse++) horses.push_back(horse);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<HorseHistory> stats(horses.size());
+    for (size_t i = 0; i < horses.size(); i++) stats[i] = history.ScanHorse(horses[i], first, races);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // Best first; large fields are cut down to the top few
+    std::vector<size_t> order(horses.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return stats[a].wins > stats[b].wins; });
+    if ((int)order.size() > LIST_ALL_MAX) order.resize(std::min((size_t)top, order.size()));
+
+    std::cout << races - first << " races (" << FormatTime(history.TimeMs(first)) << " to " << FormatTime(history.TimeMs(races - 1))
+              << "), " << numHorses << " horses" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    for (size_t i : order) {
+        const HorseHistory& horse = stats[i];
+        std::cout << "  Horse " << std::setw(3) << horses[i] + 1 << ": "
+                  << "wins " << std::setw(6) << 100.0 * horse.WinRate() << "%"
+                  << ", placed " << std::setw(6) << 100.0 * horse.placed / horse.races << "%"
+                  << ", avg " << FormatMoney((long long)horse.AverageContribution())
+                  << ", paid " << FormatMoney(horse.paid)
+                  << ", best streak " << horse.longestStreak
+                  << ", streak " << horse.currentStreak
+                  << ", since win " << horse.racesSinceWin << std::endl;
+    }
+    std::cout << "Scanned " << races - first << " races x " << horses.size() << " horses in " << ms << " ms" << std::endl;
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "task_scheduler.h"
+#include <algorithm>
+#include <iostream>
+#include <memory>
+
+TaskScheduler::TaskScheduler(int threads) : stopping(false) {
+    if (threads <= 0) {
+        threads = std::max(2, (int)std::thread::hardware_concurrency());
+    }
+    for (int i = 0; i < threads; i++) {
+        try {
+            workers.emplace_back(&TaskScheduler::WorkerLoop, this);
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to start worker thread: " << e.what() << std::endl;
+            break;
+        }
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+std::future<void> TaskScheduler::Submit(std::function<void()> task) {
+    std::packaged_task<void()> packaged(std::move(task));
+    std::future<void> future = packaged.get_future();
+    if (workers.empty()) {
+        packaged(); // No pool to run on; run inline rather than never
+        return future;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(packaged));
+    }
+    condition.notify_one();
+    return future;
+}
+
+void TaskScheduler::ParallelFor(size_t count, std::function<void(size_t)> body) {
+    if (count == 0) return;
+
+    // Shared with the helpers, which may only get to run after the work is done
+    struct State {
+        std::function<void(size_t)> body;
+        size_t count;
+        std::atomic<size_t> next;
+        std::atomic<size_t> finished;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    auto state = std::make_shared<State>();
+    state->body = std::move(body);
+    state->count = count;
+    state->next = 0;
+    state->finished = 0;
+
+    auto run = [state]() {
+        for (size_t i = state->next++; i < state->count; i = state->next++) {
+            state->body(i);
+            if (++state->finished == state->count) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->done.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min(count - 1, workers.size());
+    for (size_t i = 0; i < helpers; i++) {
+        Submit(run);
+    }
+    run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&]() { return state->finished == state->count; });
+}
+
+void TaskScheduler::WorkerLoop() {
+    while (true) {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (stopping && queue.empty()) return;
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+        task();
+    }
+}
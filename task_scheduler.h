@@ -0,0 +1,37 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of long-lived worker threads, created once and reused for every
+// asset load instead of spawning std::threads on demand.
+class TaskScheduler {
+public:
+    // threads <= 0 picks one per core (at least two, so one long task cannot starve the rest)
+    explicit TaskScheduler(int threads = 0);
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    std::future<void> Submit(std::function<void()> task);
+
+    // Run body(0..count-1) on the pool and the calling thread; returns when all are done
+    void ParallelFor(size_t count, std::function<void(size_t)> body);
+
+    int ThreadCount() const { return (int)workers.size(); }
+
+private:
+    void WorkerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::packaged_task<void()>> queue;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping;
+};